@@ -8,5 +8,12 @@ mkdir -p ./wasm/
 CFLAGS="-O3 -Wall -Wextra -g -pedantic `pkg-config --cflags raylib`"
 CLIBS="`pkg-config --libs raylib` -lm"
 
-clang $CFLAGS -o ./build/2048 ./src/gui-version.c ./src/2048.c $CLIBS
-clang --target=wasm32 -I./include/ --no-standard-libraries -Wl,--export-table -Wl,--no-entry -Wl,--allow-undefined -Wl,--export=main -Wl,--export=__head_base -Wl,--allow-undefined -o ./wasm/2048.wasm ./src/gui-version.c ./src/2048.c -DPLATFORM_WEB
+# TRACE=1 ./build.sh records trace events in the native builds (see src/trace.h)
+if [ -n "$TRACE" ]; then
+    CFLAGS="$CFLAGS -DTRACE"
+fi
+
+clang $CFLAGS -o ./build/2048 ./src/gui-version.c ./src/2048.c ./src/profiler.c ./src/simulation.c ./src/ai.c ./src/spectator.c ./src/trace.c $CLIBS -lpthread
+clang $CFLAGS -o ./build/bench ./src/bench.c ./src/2048.c ./src/trace.c
+clang $CFLAGS -o ./build/solver ./src/solver.c ./src/tablebase.c ./src/trace.c -lpthread
+clang --target=wasm32 -I./include/ --no-standard-libraries -Wl,--export-table -Wl,--no-entry -Wl,--allow-undefined -Wl,--export=main -Wl,--export=__head_base -Wl,--allow-undefined -o ./wasm/2048.wasm ./src/gui-version.c ./src/2048.c ./src/profiler.c ./src/simulation.c ./src/ai.c ./src/spectator.c ./src/wasm_math.c ./src/wasm_draw.c -DPLATFORM_WEB
@@ -1,5 +1,6 @@
 // Phony math.h. Since we are compiling with --no-standard-libraries raymath.h can't find math.h.
 // But it only needs it for few function definitions. So we've put those definitions here.
+// They are implemented in src/wasm_math.c, not imported from JavaScript.
 #ifndef MATH_H_
 #define MATH_H_
 float floorf(float);
@@ -1,15 +1,8 @@
-function make_environment(env) {
-    return new Proxy(env, {
-        get(target, prop, receiver) {
-            if (env[prop] !== undefined) {
-                return env[prop].bind(env);
-            }
-            return (...args) => {
-                throw new Error(`NOT IMPLEMENTED: ${prop} ${args}`);
-            }
-        }
-    });
-}
+// Captured while the script runs on the page, a worker is started from the same file
+const RAYLIB_JS_URL = typeof document !== "undefined" ? document.currentScript?.src : undefined;
+
+const CSS_COLOR_CACHE_SIZE = 1024;
+const TEXT_METRICS_CACHE_SIZE = 512;
 
 let iota = 0;
 const LOG_ALL     = iota++; // Display all logs
@@ -21,6 +14,37 @@ const LOG_ERROR   = iota++; // Error logging, used on unrecoverable failures
 const LOG_FATAL   = iota++; // Fatal logging, used to abort program: exit(EXIT_FAILURE)
 const LOG_NONE    = iota++; // Disable logging
 
+// Input events the page forwards to the game, see RaylibJs.#listen(). When it
+// runs in a worker they go through a ring of events in a SharedArrayBuffer.
+iota = 0;
+const INPUT_KEY_DOWN   = iota++;
+const INPUT_KEY_UP     = iota++;
+const INPUT_WHEEL      = iota++;
+const INPUT_MOUSE_MOVE = iota++;
+const INPUT_MOUSE_DOWN = iota++;
+const INPUT_MOUSE_UP   = iota++;
+const INPUT_RESIZE     = iota++;
+
+const INPUT_RING_EVENTS = 256; // a power of two
+const INPUT_RING_HEADER = 4;   // ints: events written, events read, worker asleep, unused
+const INPUT_EVENT_INTS = 3;    // the kind, then two arguments as floats
+
+// Kinds of the draw commands written by src/wasm_draw.c, in the same order
+iota = 0;
+const DRAW_CLEAR_BACKGROUND   = iota++;
+const DRAW_RECTANGLE          = iota++;
+const DRAW_RECTANGLE_REC      = iota++;
+const DRAW_RECTANGLE_ROUNDED  = iota++;
+const DRAW_TRIANGLE           = iota++;
+const DRAW_RING               = iota++;
+const DRAW_TEXT               = iota++;
+const DRAW_TEXT_EX            = iota++;
+const DRAW_TEXTURE_PRO        = iota++;
+const DRAW_BEGIN_TEXTURE_MODE = iota++;
+const DRAW_END_TEXTURE_MODE   = iota++;
+const DRAW_BEGIN_MODE_2D      = iota++;
+const DRAW_END_MODE_2D        = iota++;
+
 class RaylibJs {
     // TODO: We stole the font from the website
     // (https://raylib.com/) and it's slightly different than
@@ -34,9 +58,12 @@ class RaylibJs {
     #reset() {
         this.previous = undefined;
         this.wasm = undefined;
+        this.canvas = undefined;
         this.ctx = undefined;
+        this.webgl = undefined;
         this.dt = undefined;
         this.targetFPS = 60;
+        this.startTime = undefined;
         this.entryFunction = undefined;
         this.prevPressedKeyState = new Set();
         this.currentPressedKeyState = new Set();
@@ -46,7 +73,27 @@ class RaylibJs {
         this.prevMousePosition = {x: 0, y: 0};
         this.currentMousePosition = {x: 0, y: 0};
         this.images = [];
+        this.renderTargets = new Set();
+        this.screenCtx = undefined;
         this.quit = false;
+        this.eventWaiting = false;
+        this.windowResized = false;
+        this.wakeUp = () => {};
+        this.u8 = undefined;
+        this.u32 = undefined;
+        this.f32 = undefined;
+        this.cssColors = new Map();
+        this.fontFamily = "sans-serif";
+        this.fontLoads = [];
+        this.textMetrics = new Map();
+        this.ctxState = {font: undefined, fillStyle: undefined, textBaseline: undefined};
+        this.textDecoder = new TextDecoder();
+        this.drawCommands = undefined;
+        this.worker = undefined;
+        this.stopWorker = undefined;
+        this.inputRing = undefined;
+        this.baseURL = undefined;
+        this.windowSize = undefined;
     }
 
     constructor() {
@@ -54,95 +101,493 @@ class RaylibJs {
     }
 
     stop() {
+        if (this.worker !== undefined) {
+            this.stopWorker();
+            this.#reset();
+            return;
+        }
         this.quit = true;
+        this.wakeUp();
+    }
+
+    // Views over the memory of the wasm instance, made again only when the
+    // memory grows, which detaches the ArrayBuffer they were made for
+    #views() {
+        if (this.u8 === undefined || this.u8.byteLength === 0) {
+            const buffer = this.wasm.instance.exports.memory.buffer;
+            this.u8 = new Uint8Array(buffer);
+            this.u32 = new Uint32Array(buffer);
+            this.f32 = new Float32Array(buffer);
+        }
+    }
+
+    // CSS strings are made once per RGBA value
+    #color(color_ptr) {
+        const u8 = this.u8;
+        const rgba = (u8[color_ptr] << 24 | u8[color_ptr + 1] << 16 | u8[color_ptr + 2] << 8 | u8[color_ptr + 3]) >>> 0;
+        let color = this.cssColors.get(rgba);
+        if (color === undefined) {
+            if (this.cssColors.size >= CSS_COLOR_CACHE_SIZE) this.cssColors.clear();
+            color = color_hex_unpacked(u8[color_ptr], u8[color_ptr + 1], u8[color_ptr + 2], u8[color_ptr + 3]);
+            this.cssColors.set(rgba, color);
+        }
+        return color;
+    }
+
+    // The state of this.ctx last set through the setters below, so setting it
+    // again to the same value is skipped. Assigning a font makes the canvas
+    // parse it, which is costly enough to show up once per text of a frame.
+    // Anything that changes the state behind their back (resizing the canvas,
+    // restore(), another context) has to forget it.
+    #forgetCtxState() {
+        this.ctxState.font = undefined;
+        this.ctxState.fillStyle = undefined;
+        this.ctxState.textBaseline = undefined;
+    }
+
+    #setFont(font) {
+        if (this.ctxState.font === font) return;
+        this.ctx.font = font;
+        this.ctxState.font = font;
+    }
+
+    #setFillStyle(fillStyle) {
+        if (this.ctxState.fillStyle === fillStyle) return;
+        this.ctx.fillStyle = fillStyle;
+        this.ctxState.fillStyle = fillStyle;
+    }
+
+    #setTextBaseline(textBaseline) {
+        if (this.ctxState.textBaseline === textBaseline) return;
+        this.ctx.textBaseline = textBaseline;
+        this.ctxState.textBaseline = textBaseline;
+    }
+
+    // Width and height of the text, least recently used ones are dropped
+    // first. Forgotten whenever fonts finish loading, they were measured
+    // with the fallback before that (see #setup()).
+    #measureText(font, text) {
+        const key = font + "\n" + text;
+        let metrics = this.textMetrics.get(key);
+        if (metrics !== undefined) {
+            this.textMetrics.delete(key);
+        } else {
+            if (this.textMetrics.size >= TEXT_METRICS_CACHE_SIZE) {
+                this.textMetrics.delete(this.textMetrics.keys().next().value);
+            }
+            this.#setFont(font);
+            const measured = this.ctx.measureText(text);
+            metrics = {
+                width: measured.width,
+                height: measured.actualBoundingBoxAscent + measured.actualBoundingBoxDescent,
+            };
+        }
+        this.textMetrics.set(key, metrics);
+        return metrics;
+    }
+
+    #cstr(ptr) {
+        const u8 = this.u8;
+        let end = ptr;
+        while (u8[end] != 0) end++;
+        return this.textDecoder.decode(u8.subarray(ptr, end));
     }
     
-    async start({ wasmPath, canvasId }) {
-        if (this.wasm !== undefined) {
+    // A plain object with every function the module imports bound once, the
+    // ones raylib.js does not implement throw when they are called
+    #imports(module) {
+        const env = {};
+        for (const {module: moduleName, name, kind} of WebAssembly.Module.imports(module)) {
+            if (moduleName !== "env" || kind !== "function") continue;
+            if (typeof this[name] === "function") {
+                env[name] = this[name].bind(this);
+            } else {
+                env[name] = (...args) => {
+                    throw new Error(`NOT IMPLEMENTED: ${name} ${args}`);
+                };
+            }
+        }
+        return env;
+    }
+
+    // Runs the draw commands the module has buffered since the last time,
+    // see src/wasm_draw.c for their layout. The arguments stay in memory and
+    // are handed to the drawing functions below by address.
+    #replayDrawCommands() {
+        if (this.drawCommands === undefined) return;
+        this.#views();
+        const u32 = this.u32, f32 = this.f32;
+        const base = this.drawCommands >> 2;
+        const end = base + 1 + u32[base];
+        if (this.webgl !== undefined) {
+            this.webgl.resize(this.canvas.width, this.canvas.height);
+            for (let at = base + 1; at < end; at += u32[at] >>> 8) {
+                this.#drawWebGL(u32[at] & 0xFF, at + 1);
+            }
+            this.webgl.flush();
+            u32[base] = 0;
+            return;
+        }
+        for (let at = base + 1; at < end; at += u32[at] >>> 8) {
+            const w = at + 1;  // index of the first argument
+            const p = w << 2;  // and its address
+            switch (u32[at] & 0xFF) {
+            case DRAW_CLEAR_BACKGROUND:   this.ClearBackground(p); break;
+            case DRAW_RECTANGLE:          this.DrawRectangle(f32[w], f32[w + 1], f32[w + 2], f32[w + 3], p + 16); break;
+            case DRAW_RECTANGLE_REC:      this.DrawRectangleRec(p, p + 16); break;
+            case DRAW_RECTANGLE_ROUNDED:  this.DrawRectangleRounded(p, f32[w + 4], f32[w + 5], p + 24); break;
+            case DRAW_TRIANGLE:           this.DrawTriangle(p, p + 8, p + 16, p + 24); break;
+            case DRAW_RING:               this.DrawRing(p, f32[w + 2], f32[w + 3], f32[w + 4], f32[w + 5], f32[w + 6], p + 28); break;
+            case DRAW_TEXT:               this.DrawText(p + 16, f32[w], f32[w + 1], f32[w + 2], p + 12); break;
+            case DRAW_TEXT_EX:            this.DrawTextEx(0, p + 20, p, f32[w + 2], f32[w + 3], p + 16); break;
+            case DRAW_TEXTURE_PRO:        this.DrawTexturePro(p, p + 4, p + 20, p + 36, f32[w + 11], p + 48); break;
+            case DRAW_BEGIN_TEXTURE_MODE: this.BeginTextureMode(p); break;
+            case DRAW_END_TEXTURE_MODE:   this.EndTextureMode(); break;
+            case DRAW_BEGIN_MODE_2D:      this.BeginMode2D(p); break;
+            case DRAW_END_MODE_2D:        this.EndMode2D(); break;
+            default: throw new Error(`Unknown draw command ${u32[at] & 0xFF} at ${at << 2}`);
+            }
+        }
+        u32[base] = 0;
+    }
+
+    // The same commands for WebGLRenderer, `w` is the index of the first argument
+    #drawWebGL(kind, w) {
+        const webgl = this.webgl, u32 = this.u32, f32 = this.f32;
+        switch (kind) {
+        case DRAW_CLEAR_BACKGROUND:
+            webgl.clear(u32[w]);
+            break;
+        case DRAW_RECTANGLE:
+        case DRAW_RECTANGLE_REC:
+            webgl.rectangle(f32[w], f32[w + 1], f32[w + 2], f32[w + 3], 0, u32[w + 4]);
+            break;
+        case DRAW_RECTANGLE_ROUNDED:
+            webgl.rectangle(f32[w], f32[w + 1], f32[w + 2], f32[w + 3], Math.floor(f32[w + 4]*100), u32[w + 6]);
+            break;
+        case DRAW_TRIANGLE:
+            webgl.triangle(f32[w], f32[w + 1], f32[w + 2], f32[w + 3], f32[w + 4], f32[w + 5], u32[w + 6]);
+            break;
+        case DRAW_RING:
+            webgl.ring(f32[w], f32[w + 1], f32[w + 2], f32[w + 3], degreesToRadians(f32[w + 4]), degreesToRadians(f32[w + 5]), u32[w + 7]);
+            break;
+        case DRAW_TEXT: {
+            const fontSize = f32[w + 2]*this.#FONT_SCALE_MAGIC;
+            const lines = this.#cstr((w + 4) << 2).split('\n');
+            for (let i = 0; i < lines.length; i++) {
+                webgl.text(lines[i], f32[w], f32[w + 1] + fontSize + i*fontSize, fontSize, "grixel", false, u32[w + 3]);
+            }
+            break;
+        }
+        case DRAW_TEXT_EX:
+            webgl.text(this.#cstr((w + 5) << 2), f32[w], f32[w + 1], f32[w + 2], this.fontFamily, true, u32[w + 4]);
+            break;
+        case DRAW_TEXTURE_PRO: {
+            const id = u32[w];
+            const image = this.images[id];
+            let sy = f32[w + 2], sh = f32[w + 4];
+            // Flipped like in DrawTexturePro()
+            let flip = sh < 0;
+            sh = Math.abs(sh);
+            if (this.renderTargets.has(id)) {
+                sy = image.height - sy - sh;
+                flip = !flip;
+            }
+            webgl.texture(image, f32[w + 1], sy, f32[w + 3], sh,
+                          f32[w + 5] - f32[w + 9], f32[w + 6] - f32[w + 10], f32[w + 7], f32[w + 8], flip, u32[w + 12]);
+            break;
+        }
+        case DRAW_BEGIN_TEXTURE_MODE:
+            webgl.beginTarget(this.images[u32[w]]);
+            break;
+        case DRAW_END_TEXTURE_MODE:
+            webgl.endTarget();
+            break;
+        case DRAW_BEGIN_MODE_2D:
+            webgl.camera(...camera2D(f32[w], f32[w + 1], f32[w + 2], f32[w + 3], f32[w + 4], f32[w + 5]));
+            break;
+        case DRAW_END_MODE_2D:
+            webgl.camera(1, 0, 0, 0);
+            break;
+        default:
+            throw new Error(`Unknown draw command ${kind} at ${(w - 1) << 2}`);
+        }
+    }
+
+    raylib_js_set_draw_commands(commands_ptr) {
+        this.drawCommands = commands_ptr;
+    }
+
+    // The buffer is full before the end of the frame
+    raylib_js_flush_draw_commands() {
+        this.#replayDrawCommands();
+    }
+
+    // `renderer` is "canvas" for Canvas 2D or "webgl2" for WebGLRenderer,
+    // which falls back to Canvas 2D where WebGL2 is not available. With
+    // `worker` the game runs and draws in a Web Worker on an OffscreenCanvas
+    // and the page only forwards the input to it. That needs the page to be
+    // cross-origin isolated for the SharedArrayBuffer of the input ring,
+    // otherwise the game runs on the main thread.
+    async start({ wasmPath, canvasId, renderer = "canvas", worker = false }) {
+        if (this.wasm !== undefined || this.worker !== undefined) {
             console.error("The game is already running. Please stop() it first.");
             return;
         }
 
         const canvas = document.getElementById(canvasId);
-        this.ctx = canvas.getContext("2d");
-        if (this.ctx === null) {
-            throw new Error("Could not create 2d canvas context");
+        if (worker) {
+            if (window.crossOriginIsolated && typeof canvas.transferControlToOffscreen === "function" && RAYLIB_JS_URL !== undefined) {
+                this.#startWorker(canvas, wasmPath, renderer);
+                return;
+            }
+            console.warn("Running the game in a worker needs an OffscreenCanvas and cross-origin isolation, running it on the main thread");
         }
 
-        this.wasm = await WebAssembly.instantiateStreaming(fetch(wasmPath), {
-            env: make_environment(this)
+        this.baseURL = document.baseURI;
+        this.windowSize = {width: window.innerWidth, height: window.innerHeight};
+        this.#setup(canvas, renderer);
+        await this.#instantiate(wasmPath);
+        const unlisten = this.#listen(canvas, (kind, a, b) => {
+            this.#input(kind, a, b);
+            this.wakeUp();
         });
+        this.#loop(unlisten);
+    }
 
-        const keyDown = (e) => {
-            this.currentPressedKeyState.add(glfwKeyMapping[e.code]);
+    // Called in the worker started by #startWorker() with its first message
+    async runInWorker({ wasmPath, baseURL, canvas, renderer, ring, fonts, windowSize }) {
+        this.baseURL = baseURL;
+        this.windowSize = windowSize;
+        this.inputRing = {i32: new Int32Array(ring), f32: new Float32Array(ring)};
+        // Loaded before the first frame for the same reason as in LoadFontEx()
+        await Promise.all(fonts.map(({family, source}) => {
+            const font = new FontFace(family, source);
+            self.fonts.add(font);
+            return font.load();
+        }));
+        this.#setup(canvas, renderer);
+        await this.#instantiate(wasmPath);
+        this.#loop(() => self.close());
+    }
+
+    // The canvas can be transferred only once, so the game cannot be
+    // started again on the same page after stop()
+    #startWorker(canvas, wasmPath, renderer) {
+        const ring = new SharedArrayBuffer((INPUT_RING_HEADER + INPUT_RING_EVENTS*INPUT_EVENT_INTS)*4);
+        const i32 = new Int32Array(ring);
+        const f32 = new Float32Array(ring);
+        const offscreen = canvas.transferControlToOffscreen();
+        const worker = new Worker(RAYLIB_JS_URL);
+        worker.onmessage = ({data}) => {
+            if (data.title !== undefined) document.title = data.title;
         };
-        const keyUp = (e) => {
-            this.currentPressedKeyState.delete(glfwKeyMapping[e.code]);
+        worker.postMessage({
+            wasmPath: new URL(wasmPath, document.baseURI).href,
+            baseURL: document.baseURI,
+            canvas: offscreen,
+            renderer,
+            ring,
+            fonts: pageFontFaces(),
+            windowSize: {width: window.innerWidth, height: window.innerHeight},
+        }, [offscreen]);
+
+        // Single producer single consumer: only the page writes events and
+        // the count of written ones, only the worker the count of read ones
+        const unlisten = this.#listen(canvas, (kind, a, b) => {
+            const written = Atomics.load(i32, 0);
+            if (((written - Atomics.load(i32, 1)) | 0) >= INPUT_RING_EVENTS) return;
+            const at = INPUT_RING_HEADER + (written & (INPUT_RING_EVENTS - 1))*INPUT_EVENT_INTS;
+            i32[at] = kind;
+            f32[at + 1] = a;
+            f32[at + 2] = b;
+            Atomics.store(i32, 0, (written + 1) | 0);
+            if (Atomics.load(i32, 2) !== 0) worker.postMessage({wakeUp: true});
+        });
+        this.worker = worker;
+        this.stopWorker = () => {
+            unlisten();
+            worker.postMessage({stop: true});
         };
-        const wheelMove = (e) => {
-          this.currentMouseWheelMoveState = Math.sign(-e.deltaY);
+    }
+
+    // Applies the input events the page wrote into the ring since the last frame
+    #drainInputRing() {
+        const {i32, f32} = this.inputRing;
+        const written = Atomics.load(i32, 0);
+        let read = Atomics.load(i32, 1);
+        for (; read !== written; read = (read + 1) | 0) {
+            const at = INPUT_RING_HEADER + (read & (INPUT_RING_EVENTS - 1))*INPUT_EVENT_INTS;
+            this.#input(i32[at], f32[at + 1], f32[at + 2]);
+        }
+        Atomics.store(i32, 1, read);
+    }
+
+    // Turns the DOM events of the page into input events for #input(),
+    // returns a function that removes the listeners again
+    #listen(canvas, send) {
+        const listeners = [
+            [window, "keydown", (e) => send(INPUT_KEY_DOWN, glfwKeyMapping[e.code] ?? 0, 0)],
+            [window, "keyup", (e) => send(INPUT_KEY_UP, glfwKeyMapping[e.code] ?? 0, 0)],
+            [window, "wheel", (e) => send(INPUT_WHEEL, Math.sign(-e.deltaY), 0)],
+            [window, "mousemove", (e) => {
+                const bcrect = canvas.getBoundingClientRect();
+                send(INPUT_MOUSE_MOVE, e.clientX - bcrect.left, e.clientY - bcrect.top);
+            }],
+            [window, "mousedown", (e) => send(INPUT_MOUSE_DOWN, glfwMouseButtonMapping[e.button], 0)],
+            [window, "mouseup", (e) => send(INPUT_MOUSE_UP, glfwMouseButtonMapping[e.button], 0)],
+            [canvas, "fullscreenchange", () => send(INPUT_RESIZE, window.innerWidth, window.innerHeight)],
+        ];
+        for (const [target, type, listener] of listeners) {
+            target.addEventListener(type, listener);
+        }
+        return () => {
+            for (const [target, type, listener] of listeners) {
+                target.removeEventListener(type, listener);
+            }
         };
-        const mouseMove = (e) => {
+    }
+
+    #input(kind, a, b) {
+        switch (kind) {
+        case INPUT_KEY_DOWN:
+            this.currentPressedKeyState.add(a);
+            break;
+        case INPUT_KEY_UP:
+            this.currentPressedKeyState.delete(a);
+            break;
+        case INPUT_WHEEL:
+            this.currentMouseWheelMoveState = a;
+            break;
+        case INPUT_MOUSE_MOVE:
             this.prevMousePosition = this.currentMousePosition;
-            this.currentMousePosition = {x: e.clientX, y: e.clientY};
-        };
-        const mouseDown = (e) => {
-            this.currentMouseButtonState.add(glfwMouseButtonMapping[e.button]);
-        };
-        const mouseUp = (e) => {
-            this.currentMouseButtonState.delete(glfwMouseButtonMapping[e.button]);
-        };
-        const fullScreen = (e) => {
-            this.ctx.canvas.width  = window.innerWidth;
-            this.ctx.canvas.height = window.innerHeight;
-        };
-        window.addEventListener("keydown", keyDown);
-        window.addEventListener("keyup", keyUp);
-        window.addEventListener("wheel", wheelMove);
-        window.addEventListener("mousemove", mouseMove);
-        window.addEventListener("mousedown", mouseDown);
-        window.addEventListener("mouseup", mouseUp);
-        this.ctx.canvas.addEventListener("fullscreenchange", fullScreen);
+            this.currentMousePosition = {x: a, y: b};
+            break;
+        case INPUT_MOUSE_DOWN:
+            this.currentMouseButtonState.add(a);
+            break;
+        case INPUT_MOUSE_UP:
+            this.currentMouseButtonState.delete(a);
+            break;
+        case INPUT_RESIZE:
+            this.canvas.width = a;
+            this.canvas.height = b;
+            this.#forgetCtxState();
+            break;
+        }
+    }
+
+    #setup(canvas, renderer) {
+        if (renderer === "webgl2") {
+            const gl = canvas.getContext("webgl2", {premultipliedAlpha: true});
+            if (gl === null) {
+                console.warn("WebGL2 is not available, drawing with Canvas 2D");
+            } else {
+                try {
+                    this.webgl = new WebGLRenderer(gl);
+                } catch (error) {
+                    // The canvas belongs to the WebGL2 context now, a copy of it can get a 2d one
+                    if (typeof canvas.cloneNode !== "function") throw error;
+                    console.warn(`Could not set up WebGL2, drawing with Canvas 2D: ${error.message}`);
+                    const copy = canvas.cloneNode();
+                    canvas.replaceWith(copy);
+                    canvas = copy;
+                }
+            }
+        }
+        this.canvas = canvas;
+
+        // The canvas picks the face when the font is assigned, so it has to be
+        // assigned again too
+        fontFaceSet().addEventListener("loadingdone", () => {
+            this.textMetrics.clear();
+            this.#forgetCtxState();
+            this.webgl?.invalidateGlyphs();
+            this.wakeUp();
+        });
+        if (this.webgl !== undefined) {
+            // Text is still measured with Canvas 2D
+            this.ctx = createCanvas(1, 1).getContext("2d");
+        } else {
+            this.ctx = canvas.getContext("2d");
+            if (this.ctx === null) {
+                throw new Error("Could not create 2d canvas context");
+            }
+        }
+    }
+
+    async #instantiate(wasmPath) {
+        const module = await WebAssembly.compileStreaming(fetch(wasmPath));
+        const instance = await WebAssembly.instantiate(module, {
+            env: this.#imports(module)
+        });
+        this.wasm = {module, instance};
+    }
 
+    #loop(onQuit) {
+        // While the game waits for events (see EnableEventWaiting) no frames
+        // are requested until an input event wakes the loop up
+        let sleeping = false;
+        this.wakeUp = () => {
+            if (!sleeping) return;
+            sleeping = false;
+            if (this.inputRing !== undefined) Atomics.store(this.inputRing.i32, 2, 0);
+            requestAnimationFrame(next);
+        };
 
         this.wasm.instance.exports.main();
+        // LoadFontEx() blocks in raylib. Here the first frame waits for the
+        // fonts instead, the game renders text into textures it keeps.
+        const fontsLoaded = Promise.allSettled(this.fontLoads);
+        this.fontLoads = [];
         const next = (timestamp) => {
             if (this.quit) {
-                this.ctx.clearRect(0, 0, this.ctx.canvas.width, this.ctx.canvas.height);
-                window.removeEventListener("keydown", keyDown);
+                if (this.webgl !== undefined) {
+                    this.webgl.clear(0);
+                    this.webgl.flush();
+                } else {
+                    this.ctx.clearRect(0, 0, this.canvas.width, this.canvas.height);
+                }
+                onQuit();
                 this.#reset()
                 return;
             }
+            if (this.inputRing !== undefined) this.#drainInputRing();
             this.dt = (timestamp - this.previous)/1000.0;
             this.previous = timestamp;
             this.entryFunction();
-            window.requestAnimationFrame(next);
+            if (this.eventWaiting) {
+                sleeping = true;
+                if (this.inputRing !== undefined) {
+                    // The page only sends a wake up once it sees the flag,
+                    // events that came before it would be left waiting
+                    const i32 = this.inputRing.i32;
+                    Atomics.store(i32, 2, 1);
+                    if (Atomics.load(i32, 0) !== Atomics.load(i32, 1)) this.wakeUp();
+                }
+            } else {
+                requestAnimationFrame(next);
+            }
         };
-        window.requestAnimationFrame((timestamp) => {
+        fontsLoaded.then(() => requestAnimationFrame((timestamp) => {
             this.previous = timestamp;
-            window.requestAnimationFrame(next);
-        });
+            requestAnimationFrame(next);
+        }));
     }
     
     GetMouseDelta(result_ptr) {
-        const bcrect = this.ctx.canvas.getBoundingClientRect();
-        const cur_x = this.currentMousePosition.x - bcrect.left;
-        const cur_y = this.currentMousePosition.y - bcrect.top;
-        
-        const prev_x = this.prevMousePosition.x - bcrect.left;
-        const prev_y = this.prevMousePosition.y - bcrect.top;
-
-        const dx = cur_x - prev_x;
-        const dy = cur_y - prev_y;
+        const dx = this.currentMousePosition.x - this.prevMousePosition.x;
+        const dy = this.currentMousePosition.y - this.prevMousePosition.y;
 
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        new Float32Array(buffer, result_ptr, 2).set([dx, dy]);
+        this.#views();
+        this.f32[result_ptr >> 2] = dx;
+        this.f32[(result_ptr >> 2) + 1] = dy;
     }
 
     CheckCollisionCircles(center1_ptr, radius1, center2_ptr, radius2) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x1, y1] = new Float32Array(buffer, center1_ptr, 2);
-        const [x2, y2] = new Float32Array(buffer, center2_ptr, 2);
+        this.#views();
+        const x1 = this.f32[center1_ptr >> 2], y1 = this.f32[(center1_ptr >> 2) + 1];
+        const x2 = this.f32[center2_ptr >> 2], y2 = this.f32[(center2_ptr >> 2) + 1];
         
         var collision = false;
 
@@ -166,17 +611,37 @@ class RaylibJs {
 
     InitWindow(width, height, title_ptr) {
         if (width === 0) {
-            this.ctx.canvas.width  = window.innerWidth;
+            this.canvas.width  = this.windowSize.width;
         } else {
-            this.ctx.canvas.width = width;
+            this.canvas.width = width;
         }
         if (height === 0) { 
-            this.ctx.canvas.height = window.innerHeight;
+            this.canvas.height = this.windowSize.height;
         } else { 
-            this.ctx.canvas.height = height;
+            this.canvas.height = height;
         }
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        document.title = cstr_by_ptr(buffer, title_ptr);
+        this.#forgetCtxState();
+        this.#views();
+        const title = this.#cstr(title_ptr);
+        if (typeof document !== "undefined") {
+            document.title = title;
+        } else {
+            self.postMessage({title});
+        }
+        this.startTime = performance.now();
+    }
+
+    SetWindowSize(width, height) {
+        this.#replayDrawCommands();
+        this.canvas.width = width;
+        this.canvas.height = height;
+        this.#forgetCtxState();
+        this.windowResized = true;
+    }
+
+    // Like in raylib it stays set until the end of the frame
+    IsWindowResized() {
+        return this.windowResized;
     }
 
     WindowShouldClose(){
@@ -188,12 +653,25 @@ class RaylibJs {
         this.targetFPS = fps;
     }
 
+    EnableEventWaiting() {
+        this.eventWaiting = true;
+    }
+
+    DisableEventWaiting() {
+        this.eventWaiting = false;
+        this.wakeUp();
+    }
+
     GetScreenWidth() {
-        return this.ctx.canvas.width;
+        return this.canvas.width;
     }
 
     GetScreenHeight() {
-        return this.ctx.canvas.height;
+        return this.canvas.height;
+    }
+
+    GetTime() {
+        return (performance.now() - this.startTime)/1000.0;
     }
 
     GetFrameTime() {
@@ -205,41 +683,40 @@ class RaylibJs {
     BeginDrawing() {}
 
     EndDrawing() {
+        this.#replayDrawCommands();
         this.prevMousePosition = this.currentMousePosition;
         this.prevMouseButtonState.clear();
         this.prevMouseButtonState = new Set(this.currentMouseButtonState);
         this.prevPressedKeyState.clear();
         this.prevPressedKeyState = new Set(this.currentPressedKeyState);
         this.currentMouseWheelMoveState = 0.0;
+        this.windowResized = false;
     }
     
     
     //RLAPI void DrawCircle(int centerX, int centerY, float radius, Color color);                              // Draw a color-filled circle
     DrawCircle(x, y, radius, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
-        const color = color_hex_unpacked(r, g, b, a);
+        this.#views();
+        const color = this.#color(color_ptr);
         this.ctx.beginPath();
         this.ctx.arc(x, y, radius, 0, 2*Math.PI, false);
-        this.ctx.fillStyle = color;
+        this.#setFillStyle(color);
         this.ctx.fill();
     }
 
     DrawCircleV(center_ptr, radius, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x, y] = new Float32Array(buffer, center_ptr, 2);
-        const [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
-        const color = color_hex_unpacked(r, g, b, a);
+        this.#views();
+        const x = this.f32[center_ptr >> 2], y = this.f32[(center_ptr >> 2) + 1];
+        const color = this.#color(color_ptr);
         this.ctx.beginPath();
         this.ctx.arc(x, y, radius, 0, 2*Math.PI, false);
-        this.ctx.fillStyle = color;
+        this.#setFillStyle(color);
         this.ctx.fill();
     }
 
     DrawCircleLines(x, y, radius, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
-        const color = color_hex_unpacked(r, g, b, a);
+        this.#views();
+        const color = this.#color(color_ptr);
         this.ctx.beginPath();
         this.ctx.arc(x, y, radius, 0, 2*Math.PI, false);
         this.ctx.strokeStyle = color;
@@ -248,10 +725,9 @@ class RaylibJs {
     }
 
     DrawCircleLinesV(center_ptr, radius, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x, y] = new Float32Array(buffer, center_ptr, 2);
-        const [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
-        const color = color_hex_unpacked(r, g, b, a);
+        this.#views();
+        const x = this.f32[center_ptr >> 2], y = this.f32[(center_ptr >> 2) + 1];
+        const color = this.#color(color_ptr);
         this.ctx.beginPath();
         this.ctx.arc(x, y, radius, 0, 2*Math.PI, false);
         this.ctx.strokeStyle = color;
@@ -260,10 +736,9 @@ class RaylibJs {
     }
     
     DrawRing(center_ptr, inner_radius, outer_radius, start_angle, end_angle, segments, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x, y] = new Float32Array(buffer, center_ptr, 2);
-        const [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
-        const color = color_hex_unpacked(r, g, b, a); 
+        this.#views();
+        const x = this.f32[center_ptr >> 2], y = this.f32[(center_ptr >> 2) + 1];
+        const color = this.#color(color_ptr);
         const radius_delta = outer_radius - inner_radius;
         const radius = inner_radius + radius_delta/2; 
         start_angle = degreesToRadians(start_angle)
@@ -282,35 +757,35 @@ class RaylibJs {
 
 
     DrawCircleGradient(x, y, radius, color_ptr, color2_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
-        const [r2, g2, b2, a2] = new Uint8Array(buffer, color2_ptr, 4);
-        const color = color_hex_unpacked(r, g, b, a); 
-        const color2 = color_hex_unpacked(r2, g2, b2, a2); 
+        this.#views();
+        const color = this.#color(color_ptr);
+        const color2 = this.#color(color2_ptr);
         // Create a radial gradient
         const gradient = this.ctx.createRadialGradient(x, y, radius/2, x, y, radius);
         gradient.addColorStop(0, color);
         gradient.addColorStop(0.5, color2);
         this.ctx.beginPath();
         this.ctx.arc(x, y, radius, 0, Math.PI*2, false);
-        this.ctx.fillStyle = gradient;
+        this.#setFillStyle(gradient);
         this.ctx.fill();
     } 
 
     ClearBackground(color_ptr) {
-        this.ctx.fillStyle = getColorFromMemory(this.wasm.instance.exports.memory.buffer, color_ptr);
+        this.#views();
+        this.ctx.clearRect(0, 0, this.ctx.canvas.width, this.ctx.canvas.height);
+        this.#setFillStyle(this.#color(color_ptr));
         this.ctx.fillRect(0, 0, this.ctx.canvas.width, this.ctx.canvas.height);
     }
 
     // RLAPI void DrawText(const char *text, int posX, int posY, int fontSize, Color color); // Draw text (using default font)
     DrawText(text_ptr, posX, posY, fontSize, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const text = cstr_by_ptr(buffer, text_ptr);
-        const color = getColorFromMemory(buffer, color_ptr);
+        this.#views();
+        const text = this.#cstr(text_ptr);
+        const color = this.#color(color_ptr);
         fontSize *= this.#FONT_SCALE_MAGIC;
-        this.ctx.fillStyle = color;
+        this.#setFillStyle(color);
         // TODO: since the default font is part of Raylib the css that defines it should be located in raylib.js and not in index.html
-        this.ctx.font = `${fontSize}px grixel`;
+        this.#setFont(`${fontSize}px grixel`);
 
         const lines = text.split('\n');
         for (var i = 0; i < lines.length; i++) {
@@ -321,19 +796,19 @@ class RaylibJs {
     // RLAPI void DrawRectangle(int posX, int posY, int width, int height, Color color);
     // Draw a color-filled rectangle
     DrawRectangle(posX, posY, width, height, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const color = getColorFromMemory(buffer, color_ptr);
-        this.ctx.fillStyle = color;
+        this.#views();
+        const color = this.#color(color_ptr);
+        this.#setFillStyle(color);
         this.ctx.fillRect(posX, posY, width, height);
     }
     
     //RLAPI void DrawRectangleRounded(Rectangle rec, float roundness, int segments, Color color);              
     // Draw rectangle with rounded edges
     DrawRectangleRounded(rec_ptr, roundness, segments, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [posX, posY, width, height] = new Float32Array(buffer, rec_ptr, 4);
-        const color = getColorFromMemory(buffer, color_ptr);
-        this.ctx.fillStyle = color;
+        this.#views();
+        const posX = this.f32[rec_ptr >> 2], posY = this.f32[(rec_ptr >> 2) + 1], width = this.f32[(rec_ptr >> 2) + 2], height = this.f32[(rec_ptr >> 2) + 3];
+        const color = this.#color(color_ptr);
+        this.#setFillStyle(color);
         this.ctx.beginPath();
         this.ctx.roundRect(posX, posY, width, height, [Math.floor(roundness*100)]);
         this.ctx.fill();
@@ -341,23 +816,23 @@ class RaylibJs {
     
     //RLAPI void DrawTriangle(Vector2 v1, Vector2 v2, Vector2 v3, Color color); // Draw a color-filled triangle (vertex in counter-clockwise order!)
     DrawTriangle(v1, v2, v3, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x1, y1] = new Float32Array(buffer, v1, 2);
-        const [x2, y2] = new Float32Array(buffer, v2, 2);
-        const [x3, y3] = new Float32Array(buffer, v3, 2);
-        const color = getColorFromMemory(buffer, color_ptr);
+        this.#views();
+        const x1 = this.f32[v1 >> 2], y1 = this.f32[(v1 >> 2) + 1];
+        const x2 = this.f32[v2 >> 2], y2 = this.f32[(v2 >> 2) + 1];
+        const x3 = this.f32[v3 >> 2], y3 = this.f32[(v3 >> 2) + 1];
+        const color = this.#color(color_ptr);
         this.ctx.beginPath();
         this.ctx.moveTo(x1, y1);
         this.ctx.lineTo(x2, y2);
         this.ctx.lineTo(x3, y3);
-        this.ctx.fillStyle = color;
+        this.#setFillStyle(color);
         this.ctx.fill();
     }
 
     // RLAPI void DrawRectangleLines(int posX, int posY, int width, int height, Color color); // Draw rectangle outline
     DrawRectangleLines(posX, posY, width, height, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const color = getColorFromMemory(buffer, color_ptr);
+        this.#views();
+        const color = this.#color(color_ptr);
         this.ctx.strokeStyle = color;
         this.ctx.strokeRect(posX, posY, width, height);
     }
@@ -393,8 +868,8 @@ class RaylibJs {
 
     TraceLog(logLevel, text_ptr, ... args) {
         // TODO: Implement printf style formatting for TraceLog
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const text = cstr_by_ptr(buffer, text_ptr);
+        this.#views();
+        const text = this.#cstr(text_ptr);
         switch(logLevel) {
         case LOG_ALL:     console.log(`ALL: ${text} ${args}`);     break;
         case LOG_TRACE:   console.log(`TRACE: ${text} ${args}`);   break;
@@ -407,72 +882,78 @@ class RaylibJs {
         }
     }
 
+    // Relative to the canvas already, see #listen()
     GetMousePosition(result_ptr) {
-        const bcrect = this.ctx.canvas.getBoundingClientRect();
-        const x = this.currentMousePosition.x - bcrect.left;
-        const y = this.currentMousePosition.y - bcrect.top;
+        const x = this.currentMousePosition.x;
+        const y = this.currentMousePosition.y;
 
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        new Float32Array(buffer, result_ptr, 2).set([x, y]);
+        this.#views();
+        this.f32[result_ptr >> 2] = x;
+        this.f32[(result_ptr >> 2) + 1] = y;
     }
 
     CheckCollisionPointRec(point_ptr, rec_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x, y] = new Float32Array(buffer, point_ptr, 2);
-        const [rx, ry, rw, rh] = new Float32Array(buffer, rec_ptr, 4);
+        this.#views();
+        const x = this.f32[point_ptr >> 2], y = this.f32[(point_ptr >> 2) + 1];
+        const rx = this.f32[rec_ptr >> 2], ry = this.f32[(rec_ptr >> 2) + 1], rw = this.f32[(rec_ptr >> 2) + 2], rh = this.f32[(rec_ptr >> 2) + 3];
         return ((x >= rx) && x <= (rx + rw) && (y >= ry) && y <= (ry + rh));
     }
 
     Fade(result_ptr, color_ptr, alpha) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [r, g, b, _] = new Uint8Array(buffer, color_ptr, 4);
+        this.#views();
+        const r = this.u8[color_ptr], g = this.u8[color_ptr + 1], b = this.u8[color_ptr + 2];
         const newA = Math.max(0, Math.min(255, 255.0*alpha));
-        new Uint8Array(buffer, result_ptr, 4).set([r, g, b, newA]);
+        this.u8[result_ptr] = r;
+        this.u8[result_ptr + 1] = g;
+        this.u8[result_ptr + 2] = b;
+        this.u8[result_ptr + 3] = newA;
     }
 
     ColorAlpha(result_ptr, color_ptr, alpha) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [r, g, b, _] = new Uint8Array(buffer, color_ptr, 4);
+        this.#views();
+        const r = this.u8[color_ptr], g = this.u8[color_ptr + 1], b = this.u8[color_ptr + 2];
 
         if (alpha < 0.0) alpha = 0.0;
         else if (alpha > 1.0) alpha = 1.0;
 
         const newA = 255*alpha;
 
-        new Uint8Array(buffer, result_ptr, 4).set([r, g, b, newA]);
+        this.u8[result_ptr] = r;
+        this.u8[result_ptr + 1] = g;
+        this.u8[result_ptr + 2] = b;
+        this.u8[result_ptr + 3] = newA;
     }
 
     DrawRectangleRec(rec_ptr, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x, y, w, h] = new Float32Array(buffer, rec_ptr, 4);
-        const color = getColorFromMemory(buffer, color_ptr);
-        this.ctx.fillStyle = color;
+        this.#views();
+        const x = this.f32[rec_ptr >> 2], y = this.f32[(rec_ptr >> 2) + 1], w = this.f32[(rec_ptr >> 2) + 2], h = this.f32[(rec_ptr >> 2) + 3];
+        const color = this.#color(color_ptr);
+        this.#setFillStyle(color);
         this.ctx.fillRect(x, y, w, h);
     }
     
     DrawRectangleLinesEx(rec_ptr, lineThick, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [x, y, w, h] = new Float32Array(buffer, rec_ptr, 4);
-        const color = getColorFromMemory(buffer, color_ptr);
+        this.#views();
+        const x = this.f32[rec_ptr >> 2], y = this.f32[(rec_ptr >> 2) + 1], w = this.f32[(rec_ptr >> 2) + 2], h = this.f32[(rec_ptr >> 2) + 3];
+        const color = this.#color(color_ptr);
         this.ctx.strokeStyle = color;
         this.ctx.lineWidth = lineThick;
         this.ctx.strokeRect(x + lineThick/2, y + lineThick/2, w - lineThick, h - lineThick);
     }
 
     MeasureText(text_ptr, fontSize) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const text = cstr_by_ptr(buffer, text_ptr);
+        this.#views();
+        const text = this.#cstr(text_ptr);
         fontSize *= this.#FONT_SCALE_MAGIC;
-        this.ctx.font = `${fontSize}px grixel`;
-        return this.ctx.measureText(text).width;
+        return this.#measureText(`${fontSize}px grixel`, text).width;
     }
 
     TextSubtext(text_ptr, position, length) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const text = cstr_by_ptr(buffer, text_ptr);
+        this.#views();
+        const text = this.#cstr(text_ptr);
         const subtext = text.substring(position, length);
 
-        var bytes = new Uint8Array(buffer, 0, subtext.length+1);
+        var bytes = this.u8.subarray(0, subtext.length+1);
         for(var i = 0; i < subtext.length; i++) {
             bytes[i] = subtext.charCodeAt(i);
         }
@@ -483,10 +964,10 @@ class RaylibJs {
 
     // RLAPI Texture2D LoadTexture(const char *fileName);
     LoadTexture(result_ptr, filename_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const filename = cstr_by_ptr(buffer, filename_ptr);
+        this.#views();
+        const filename = this.#cstr(filename_ptr);
 
-        var result = new Uint32Array(buffer, result_ptr, 5)
+        var result = this.u32.subarray(result_ptr >> 2, (result_ptr >> 2) + 5);
         var img = new Image();
         img.src = filename;
         this.images.push(img);
@@ -503,60 +984,150 @@ class RaylibJs {
 
     // RLAPI void DrawTexture(Texture2D texture, int posX, int posY, Color tint);
     DrawTexture(texture_ptr, posX, posY, color_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [id, width, height, mipmaps, format] = new Uint32Array(buffer, texture_ptr, 5);
+        this.#views();
+        const id = this.u32[texture_ptr >> 2], width = this.u32[(texture_ptr >> 2) + 1], height = this.u32[(texture_ptr >> 2) + 2], mipmaps = this.u32[(texture_ptr >> 2) + 3], format = this.u32[(texture_ptr >> 2) + 4];
         // // TODO: implement tinting for DrawTexture
-        // const tint = getColorFromMemory(buffer, color_ptr);
+        // const tint = this.#color(color_ptr);
 
         this.ctx.drawImage(this.images[id], posX, posY);
     }
 
+    // RLAPI void DrawTexturePro(Texture2D texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint);
+    DrawTexturePro(texture_ptr, source_ptr, dest_ptr, origin_ptr, rotation, tint_ptr) {
+        this.#views();
+        const id = this.u32[texture_ptr >> 2];
+        let sx = this.f32[source_ptr >> 2], sy = this.f32[(source_ptr >> 2) + 1], sw = this.f32[(source_ptr >> 2) + 2], sh = this.f32[(source_ptr >> 2) + 3];
+        const dx = this.f32[dest_ptr >> 2], dy = this.f32[(dest_ptr >> 2) + 1], dw = this.f32[(dest_ptr >> 2) + 2], dh = this.f32[(dest_ptr >> 2) + 3];
+        const ox = this.f32[origin_ptr >> 2], oy = this.f32[(origin_ptr >> 2) + 1];
+        // TODO: implement rotation and tinting for DrawTexturePro
+        const image = this.images[id];
+
+        // Like in OpenGL render textures are addressed upside down, so the
+        // usual negative source height of the C code draws them upright
+        let flip = sh < 0;
+        sh = Math.abs(sh);
+        if (this.renderTargets.has(id)) {
+            sy = image.height - sy - sh;
+            flip = !flip;
+        }
+
+        if (flip) {
+            this.ctx.save();
+            this.ctx.translate(dx - ox, dy - oy + dh);
+            this.ctx.scale(1, -1);
+            this.ctx.drawImage(image, sx, sy, sw, sh, 0, 0, dw, dh);
+            this.ctx.restore();
+        } else {
+            this.ctx.drawImage(image, sx, sy, sw, sh, dx - ox, dy - oy, dw, dh);
+        }
+    }
+
+    // RLAPI RenderTexture2D LoadRenderTexture(int width, int height);
+    LoadRenderTexture(result_ptr, width, height) {
+        this.#views();
+        if (this.webgl !== undefined) {
+            this.images.push(this.webgl.createTarget(width, height));
+        } else {
+            this.images.push(createCanvas(width, height));
+        }
+        const id = this.images.length - 1;
+        this.renderTargets.add(id);
+
+        const result = this.u32.subarray(result_ptr >> 2, (result_ptr >> 2) + 11);
+        result.fill(0);
+        result[0] = id;     // framebuffer id
+        result[1] = id;     // texture.id
+        result[2] = width;  // texture.width
+        result[3] = height; // texture.height
+        result[4] = 1;      // texture.mipmaps
+        result[5] = 7;      // texture.format PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+    }
+
+    UnloadRenderTexture(target_ptr) {
+        this.#replayDrawCommands();
+        this.#views();
+        const id = this.u32[target_ptr >> 2];
+        this.webgl?.deleteTarget(this.images[id]);
+        this.renderTargets.delete(id);
+        this.images[id] = undefined;
+    }
+
+    BeginTextureMode(target_ptr) {
+        this.#views();
+        const id = this.u32[target_ptr >> 2];
+        this.screenCtx = this.ctx;
+        this.ctx = this.images[id].getContext("2d");
+        this.#forgetCtxState();
+    }
+
+    EndTextureMode() {
+        this.ctx = this.screenCtx;
+        this.screenCtx = undefined;
+        this.#forgetCtxState();
+    }
+
+    // RLAPI void BeginMode2D(Camera2D camera);
+    BeginMode2D(camera_ptr) {
+        this.#views();
+        const offsetX = this.f32[camera_ptr >> 2], offsetY = this.f32[(camera_ptr >> 2) + 1], targetX = this.f32[(camera_ptr >> 2) + 2], targetY = this.f32[(camera_ptr >> 2) + 3], rotation = this.f32[(camera_ptr >> 2) + 4], zoom = this.f32[(camera_ptr >> 2) + 5];
+        const [cos, sin, x, y] = camera2D(offsetX, offsetY, targetX, targetY, rotation, zoom);
+        this.ctx.save();
+        this.ctx.setTransform(cos, sin, -sin, cos, x, y);
+    }
+
+    EndMode2D() {
+        this.ctx.restore();
+        this.#forgetCtxState();
+    }
+
+    GetWindowScaleDPI(result_ptr) {
+        this.#views();
+        this.f32[result_ptr >> 2] = 1;
+        this.f32[(result_ptr >> 2) + 1] = 1;
+    }
+
     // TODO: codepoints are not implemented
     LoadFontEx(result_ptr, fileName_ptr/*, fontSize, codepoints, codepointCount*/) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const fileName = cstr_by_ptr(buffer, fileName_ptr);
+        this.#views();
+        const fileName = this.#cstr(fileName_ptr);
         // TODO: dynamically generate the name for the font
         // Support more than one custom font
-        const font = new FontFace("myfont", `url(${fileName})`);
-        document.fonts.add(font);
-        font.load();
+        const font = new FontFace("myfont", `url(${new URL(fileName, this.baseURL).href})`);
+        fontFaceSet().add(font);
+        // Text is drawn with the fallback until then. Had the canvas already
+        // seen "myfont" before it loaded, a worker would keep drawing the
+        // fallback for it, and the text metrics would be cached for it.
+        this.fontLoads.push(font.load().then(() => {
+            this.fontFamily = "myfont";
+            this.wakeUp();
+        }));
     }
 
     GenTextureMipmaps() {}
     SetTextureFilter() {}
 
     MeasureTextEx(result_ptr, font, text_ptr, fontSize, spacing) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const text = cstr_by_ptr(buffer, text_ptr);
-        const result = new Float32Array(buffer, result_ptr, 2);
-        this.ctx.font = fontSize+"px myfont";
-        const metrics = this.ctx.measureText(text)
-        result[0] = metrics.width;
-        result[1] = metrics.actualBoundingBoxAscent + metrics.actualBoundingBoxDescent; 
+        this.#views();
+        const text = this.#cstr(text_ptr);
+        const metrics = this.#measureText(fontSize+"px "+this.fontFamily, text);
+        this.f32[result_ptr >> 2] = metrics.width;
+        this.f32[(result_ptr >> 2) + 1] = metrics.height;
     }
     
     DrawTextEx(font, text_ptr, position_ptr, fontSize, spacing, tint_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const text = cstr_by_ptr(buffer, text_ptr);
-        const [posX, posY] = new Float32Array(buffer, position_ptr, 2);
-        const tint = getColorFromMemory(buffer, tint_ptr);
-        this.ctx.textBaseline = 'top';
-        this.ctx.fillStyle = tint;
-        this.ctx.font = fontSize+"px myfont";
+        this.#views();
+        const text = this.#cstr(text_ptr);
+        const posX = this.f32[position_ptr >> 2], posY = this.f32[(position_ptr >> 2) + 1];
+        const tint = this.#color(tint_ptr);
+        this.#setTextBaseline('top');
+        this.#setFillStyle(tint);
+        this.#setFont(fontSize+"px "+this.fontFamily);
         this.ctx.fillText(text, posX, posY);
     }
     
-    Vector2Distance(vector1_ptr, vector2_ptr) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        const [v1_x, v1_y] = new Float32Array(buffer, vector1_ptr, 2);
-        const [v2_x, v2_y] = new Float32Array(buffer, vector2_ptr, 2);
-
-        return Math.sqrt((v1_x - v2_x)*(v1_x - v2_x) + (v1_y - v2_y)*(v1_y - v2_y));
-    }
-    
     ColorBrightness(result_ptr, color_ptr, factor) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
-        var [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
+        this.#views();
+        var r = this.u8[color_ptr], g = this.u8[color_ptr + 1], b = this.u8[color_ptr + 2], a = this.u8[color_ptr + 3];
 
         if (factor > 1.0) factor = 1.0;
         else if (factor < -1.0) factor = -1.0;
@@ -572,32 +1143,15 @@ class RaylibJs {
             b = (255 - b)*factor + b;
         }
 
-        new Uint8Array(buffer, result_ptr, 4).set([r, g, b, a]);
+        this.u8[result_ptr] = r;
+        this.u8[result_ptr + 1] = g;
+        this.u8[result_ptr + 2] = b;
+        this.u8[result_ptr + 3] = a;
     }
    
     // RMAPI float Lerp(float start, float end, float amount)
-    Lerp(start, end, amount) {
-        return start + amount*(end - start);
-    }
-    
-    pow(value, p) {
-        return Math.pow(value, p)
-    }
-    
-    log2(value) {
-        return Math.log2(value)
-    }
-
-    sinf(value) {
-        return Math.sin(value);
-    }
-    
-    cosf(value) {
-        return Math.cos(value);
-    }
-
     ColorFromHSV(result_ptr, hue, saturation, value) {
-        const buffer = this.wasm.instance.exports.memory.buffer;
+        this.#views();
         var k = (5.0 + hue/60.0) %  6;
         var t = 4.0 - k;
         k = (t < k)? t : k;
@@ -620,11 +1174,10 @@ class RaylibJs {
         k = (k < 1)? k : 1;
         k = (k > 0)? k : 0;
         var b = ((value - value*saturation*k)*255.0);
-        new Uint8Array(buffer, result_ptr, 4).set([r, g, b, 255]);
-    }
-
-    fmod(x, y) {
-        return x % y;
+        this.u8[result_ptr] = r;
+        this.u8[result_ptr + 1] = g;
+        this.u8[result_ptr + 2] = b;
+        this.u8[result_ptr + 3] = 255;
     }
 
     raylib_js_set_entry(entry) {
@@ -632,6 +1185,431 @@ class RaylibJs {
     }
 }
 
+// Per instance of WebGLRenderer: three vec4 of shape parameters, the color as
+// 4 bytes and the shape
+const WEBGL_INSTANCE_FLOATS = 14;
+const WEBGL_MAX_INSTANCES = 16*1024;
+const GLYPH_ATLAS_FONT_SIZE = 64; // scaled down with mipmaps, text is never drawn much bigger
+const GLYPH_ATLAS_WIDTH = 1024;
+const GLYPH_ATLAS_PAD = 2;
+
+iota = 0;
+const SHAPE_RECTANGLE = iota++; // a: x, y, width, height  b.x: corner radius
+const SHAPE_TEXTURE   = iota++; // a: destination  b: source in 0..1 from the top left  c.x: 1 to flip it
+const SHAPE_RING      = iota++; // a: bounds  b: center, inner and outer radius  c.xy: start and end angle
+const SHAPE_TRIANGLE  = iota++; // a: first and second vertex  b.xy: third vertex
+
+const WEBGL_SHAPES = `
+#define SHAPE_RECTANGLE ${SHAPE_RECTANGLE}
+#define SHAPE_TEXTURE ${SHAPE_TEXTURE}
+#define SHAPE_RING ${SHAPE_RING}
+#define SHAPE_TRIANGLE ${SHAPE_TRIANGLE}
+`;
+
+const WEBGL_VERTEX_SHADER = `#version 300 es
+${WEBGL_SHAPES}
+uniform vec2 u_resolution;
+uniform vec4 u_view; // the 2D camera, see camera2D()
+
+layout(location = 0) in vec4 a_a;
+layout(location = 1) in vec4 a_b;
+layout(location = 2) in vec4 a_c;
+layout(location = 3) in vec4 a_color;
+layout(location = 4) in float a_shape;
+
+out vec2 v_position;
+out vec2 v_uv;
+out vec4 v_color;
+flat out vec4 v_a;
+flat out vec4 v_b;
+flat out vec4 v_c;
+flat out int v_shape;
+
+void main() {
+    // Four vertices of a triangle strip per instance
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    int shape = int(a_shape);
+    vec2 position = a_a.xy + corner*a_a.zw;
+    if (shape == SHAPE_TRIANGLE) {
+        position = gl_VertexID == 0 ? a_a.xy : gl_VertexID == 1 ? a_a.zw : a_b.xy;
+    }
+
+    // Textures are uploaded flipped and render targets drawn with y going
+    // down, so in both y from the top is 1 - t
+    vec2 source = a_b.xy + vec2(corner.x, a_c.x > 0.5 ? 1.0 - corner.y : corner.y)*a_b.zw;
+    v_uv = vec2(source.x, 1.0 - source.y);
+
+    v_position = position;
+    v_color = vec4(a_color.rgb*a_color.a, a_color.a);
+    v_a = a_a;
+    v_b = a_b;
+    v_c = a_c;
+    v_shape = shape;
+
+    vec2 screen = mat2(u_view.x, u_view.y, -u_view.y, u_view.x)*position + u_view.zw;
+    gl_Position = vec4(screen/u_resolution*2.0 - 1.0, 0.0, 1.0)*vec4(1.0, -1.0, 1.0, 1.0);
+}
+`;
+
+const WEBGL_FRAGMENT_SHADER = `#version 300 es
+precision highp float;
+${WEBGL_SHAPES}
+#define TAU 6.28318530717958647692
+
+uniform sampler2D u_texture;
+
+in vec2 v_position;
+in vec2 v_uv;
+in vec4 v_color;
+flat in vec4 v_a;
+flat in vec4 v_b;
+flat in vec4 v_c;
+flat in int v_shape;
+
+out vec4 color;
+
+void main() {
+    float coverage = 1.0;
+    if (v_shape == SHAPE_RECTANGLE) {
+        // Signed distance to the rounded rectangle, antialiased over a pixel
+        vec2 half_size = v_a.zw*0.5;
+        float radius = min(v_b.x, min(half_size.x, half_size.y));
+        vec2 q = abs(v_position - v_a.xy - half_size) - half_size + radius;
+        float d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+        coverage = clamp(0.5 - d/max(fwidth(d), 1e-3), 0.0, 1.0);
+    } else if (v_shape == SHAPE_RING) {
+        vec2 p = v_position - v_b.xy;
+        float r = length(p);
+        float d = abs(r - (v_b.z + v_b.w)*0.5) - (v_b.w - v_b.z)*0.5;
+        coverage = clamp(0.5 - d/fwidth(r), 0.0, 1.0);
+        float sweep = v_c.y - v_c.x;
+        if (sweep < TAU && mod(atan(p.y, p.x) - v_c.x, TAU) > sweep) coverage = 0.0;
+    } else if (v_shape == SHAPE_TEXTURE) {
+        color = texture(u_texture, v_uv)*v_color;
+        return;
+    }
+    color = v_color*coverage;
+}
+`;
+
+// Draws the commands of src/wasm_draw.c with WebGL2: every shape is an
+// instance of one quad, appended to a single vertex buffer and drawn in as
+// few instanced draw calls as texture and target changes allow. Rounded
+// rectangles and rings are cut out in the fragment shader, text is made of
+// quads from a glyph atlas rendered once per font with Canvas 2D.
+class WebGLRenderer {
+    constructor(gl) {
+        this.gl = gl;
+        this.program = this.#program(WEBGL_VERTEX_SHADER, WEBGL_FRAGMENT_SHADER);
+        this.resolutionLocation = gl.getUniformLocation(this.program, "u_resolution");
+        this.viewLocation = gl.getUniformLocation(this.program, "u_view");
+
+        this.instances = new ArrayBuffer(WEBGL_MAX_INSTANCES*WEBGL_INSTANCE_FLOATS*4);
+        this.f32 = new Float32Array(this.instances);
+        this.u32 = new Uint32Array(this.instances);
+        this.count = 0;
+
+        this.vao = gl.createVertexArray();
+        gl.bindVertexArray(this.vao);
+        this.buffer = gl.createBuffer();
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.buffer);
+        gl.bufferData(gl.ARRAY_BUFFER, this.instances.byteLength, gl.STREAM_DRAW);
+        const stride = WEBGL_INSTANCE_FLOATS*4;
+        for (let i = 0; i < 3; i++) {
+            gl.enableVertexAttribArray(i);
+            gl.vertexAttribPointer(i, 4, gl.FLOAT, false, stride, i*16);
+            gl.vertexAttribDivisor(i, 1);
+        }
+        gl.enableVertexAttribArray(3);
+        gl.vertexAttribPointer(3, 4, gl.UNSIGNED_BYTE, true, stride, 48);
+        gl.vertexAttribDivisor(3, 1);
+        gl.enableVertexAttribArray(4);
+        gl.vertexAttribPointer(4, 1, gl.FLOAT, false, stride, 52);
+        gl.vertexAttribDivisor(4, 1);
+
+        gl.useProgram(this.program);
+        gl.enable(gl.BLEND);
+        gl.blendFunc(gl.ONE, gl.ONE_MINUS_SRC_ALPHA); // colors are premultiplied
+        gl.pixelStorei(gl.UNPACK_FLIP_Y_WEBGL, true);
+        gl.pixelStorei(gl.UNPACK_PREMULTIPLY_ALPHA_WEBGL, true);
+
+        this.screenWidth = gl.canvas.width;
+        this.screenHeight = gl.canvas.height;
+        this.target = undefined;
+        this.boundTexture = null;
+        this.imageTextures = new WeakMap();
+        this.glyphs = new Map();
+        this.camera(1, 0, 0, 0);
+        this.#bindTarget();
+    }
+
+    #program(vertexSource, fragmentSource) {
+        const gl = this.gl;
+        const program = gl.createProgram();
+        for (const [type, source] of [[gl.VERTEX_SHADER, vertexSource], [gl.FRAGMENT_SHADER, fragmentSource]]) {
+            const shader = gl.createShader(type);
+            gl.shaderSource(shader, source);
+            gl.compileShader(shader);
+            if (!gl.getShaderParameter(shader, gl.COMPILE_STATUS)) {
+                throw new Error(`Could not compile shader: ${gl.getShaderInfoLog(shader)}`);
+            }
+            gl.attachShader(program, shader);
+        }
+        gl.linkProgram(program);
+        if (!gl.getProgramParameter(program, gl.LINK_STATUS)) {
+            throw new Error(`Could not link program: ${gl.getProgramInfoLog(program)}`);
+        }
+        return program;
+    }
+
+    // Index of the first float of a new instance
+    #instance(shape, rgba) {
+        if (this.count === WEBGL_MAX_INSTANCES) this.flush();
+        const i = this.count++*WEBGL_INSTANCE_FLOATS;
+        this.u32[i + 12] = rgba;
+        this.f32[i + 13] = shape;
+        return i;
+    }
+
+    flush() {
+        if (this.count === 0) return;
+        const gl = this.gl;
+        gl.bufferSubData(gl.ARRAY_BUFFER, 0, this.f32, 0, this.count*WEBGL_INSTANCE_FLOATS);
+        gl.drawArraysInstanced(gl.TRIANGLE_STRIP, 0, 4, this.count);
+        this.count = 0;
+    }
+
+    #bindTarget() {
+        const gl = this.gl;
+        const target = this.target;
+        const width = target === undefined ? this.screenWidth : target.width;
+        const height = target === undefined ? this.screenHeight : target.height;
+        gl.bindFramebuffer(gl.FRAMEBUFFER, target === undefined ? null : target.framebuffer);
+        gl.viewport(0, 0, width, height);
+        gl.uniform2f(this.resolutionLocation, width, height);
+    }
+
+    #useTexture(texture) {
+        if (texture === this.boundTexture) return;
+        this.flush();
+        this.gl.bindTexture(this.gl.TEXTURE_2D, texture);
+        this.boundTexture = texture;
+    }
+
+    #texture(width, height, source) {
+        const gl = this.gl;
+        const texture = gl.createTexture();
+        this.#useTexture(texture);
+        if (source === undefined) {
+            gl.texImage2D(gl.TEXTURE_2D, 0, gl.RGBA, width, height, 0, gl.RGBA, gl.UNSIGNED_BYTE, null);
+        } else {
+            gl.texImage2D(gl.TEXTURE_2D, 0, gl.RGBA, gl.RGBA, gl.UNSIGNED_BYTE, source);
+        }
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.LINEAR);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    // Size of the canvas, which may have changed since the last frame
+    resize(width, height) {
+        if (width === this.screenWidth && height === this.screenHeight) return;
+        this.flush();
+        this.screenWidth = width;
+        this.screenHeight = height;
+        if (this.target === undefined) this.#bindTarget();
+    }
+
+    createTarget(width, height) {
+        const gl = this.gl;
+        const texture = this.#texture(width, height);
+        const framebuffer = gl.createFramebuffer();
+        gl.bindFramebuffer(gl.FRAMEBUFFER, framebuffer);
+        gl.framebufferTexture2D(gl.FRAMEBUFFER, gl.COLOR_ATTACHMENT0, gl.TEXTURE_2D, texture, 0);
+        this.#bindTarget();
+        return {texture, framebuffer, width, height};
+    }
+
+    deleteTarget(target) {
+        this.flush();
+        if (this.boundTexture === target.texture) this.#useTexture(null);
+        this.gl.deleteFramebuffer(target.framebuffer);
+        this.gl.deleteTexture(target.texture);
+    }
+
+    beginTarget(target) {
+        this.flush();
+        // Sampling the texture of the framebuffer would make every draw fail
+        if (this.boundTexture === target.texture) this.#useTexture(null);
+        this.target = target;
+        this.#bindTarget();
+    }
+
+    endTarget() {
+        this.flush();
+        this.target = undefined;
+        this.#bindTarget();
+    }
+
+    // The zoomed cosine and sine of the rotation and the translation, see camera2D()
+    camera(cos, sin, x, y) {
+        this.flush();
+        this.gl.uniform4f(this.viewLocation, cos, sin, x, y);
+    }
+
+    clear(rgba) {
+        this.flush();
+        const a = (rgba >>> 24)/255;
+        this.gl.clearColor((rgba & 0xFF)/255*a, (rgba >>> 8 & 0xFF)/255*a, (rgba >>> 16 & 0xFF)/255*a, a);
+        this.gl.clear(this.gl.COLOR_BUFFER_BIT);
+    }
+
+    rectangle(x, y, width, height, radius, rgba) {
+        const i = this.#instance(SHAPE_RECTANGLE, rgba);
+        const f32 = this.f32;
+        f32[i] = x;
+        f32[i + 1] = y;
+        f32[i + 2] = width;
+        f32[i + 3] = height;
+        f32[i + 4] = radius;
+    }
+
+    triangle(x1, y1, x2, y2, x3, y3, rgba) {
+        const i = this.#instance(SHAPE_TRIANGLE, rgba);
+        const f32 = this.f32;
+        f32[i] = x1;
+        f32[i + 1] = y1;
+        f32[i + 2] = x2;
+        f32[i + 3] = y2;
+        f32[i + 4] = x3;
+        f32[i + 5] = y3;
+    }
+
+    // Angles in radians, like the arc of DrawRing() on Canvas 2D
+    ring(x, y, innerRadius, outerRadius, startAngle, endAngle, rgba) {
+        if (startAngle > endAngle) [startAngle, endAngle] = [endAngle, startAngle];
+        const i = this.#instance(SHAPE_RING, rgba);
+        const f32 = this.f32;
+        const bounds = outerRadius + 1;
+        f32[i] = x - bounds;
+        f32[i + 1] = y - bounds;
+        f32[i + 2] = 2*bounds;
+        f32[i + 3] = 2*bounds;
+        f32[i + 4] = x;
+        f32[i + 5] = y;
+        f32[i + 6] = innerRadius;
+        f32[i + 7] = outerRadius;
+        f32[i + 8] = startAngle;
+        f32[i + 9] = endAngle;
+    }
+
+    // Source rectangle in pixels from the top left of `image`, which is a
+    // target of createTarget() or an image element that has loaded
+    texture(image, sx, sy, sw, sh, dx, dy, dw, dh, flip, rgba) {
+        let texture = image.texture;
+        if (texture === undefined) {
+            if (!image.complete) return;
+            texture = this.imageTextures.get(image);
+            if (texture === undefined) {
+                texture = this.#texture(image.width, image.height, image);
+                this.imageTextures.set(image, texture);
+            }
+        }
+        this.#useTexture(texture);
+        this.#textureQuad(dx, dy, dw, dh, sx/image.width, sy/image.height, sw/image.width, sh/image.height, flip, rgba);
+    }
+
+    #textureQuad(dx, dy, dw, dh, u, v, uw, vh, flip, rgba) {
+        const i = this.#instance(SHAPE_TEXTURE, rgba);
+        const f32 = this.f32;
+        f32[i] = dx;
+        f32[i + 1] = dy;
+        f32[i + 2] = dw;
+        f32[i + 3] = dh;
+        f32[i + 4] = u;
+        f32[i + 5] = v;
+        f32[i + 6] = uw;
+        f32[i + 7] = vh;
+        f32[i + 8] = flip ? 1 : 0;
+    }
+
+    // `top` puts y at the top of the em box like textBaseline "top", otherwise
+    // y is the alphabetic baseline
+    text(text, x, y, fontSize, family, top, rgba) {
+        const atlas = this.#glyphAtlas(family);
+        const scale = fontSize/GLYPH_ATLAS_FONT_SIZE;
+        const baseline = top ? y + atlas.top*scale : y;
+        this.#useTexture(atlas.texture);
+        for (let i = 0; i < text.length; i++) {
+            const glyph = atlas.glyphs[text.charCodeAt(i)] ?? atlas.glyphs[63]; // '?'
+            this.#textureQuad(x - glyph.left*scale, baseline - glyph.ascent*scale, glyph.width*scale, glyph.height*scale,
+                              glyph.x/atlas.width, glyph.y/atlas.height, glyph.width/atlas.width, glyph.height/atlas.height,
+                              false, rgba);
+            x += glyph.advance*scale;
+        }
+    }
+
+    // Fonts that finished loading replace the fallback the atlases were made with
+    invalidateGlyphs() {
+        this.flush();
+        for (const atlas of this.glyphs.values()) {
+            if (this.boundTexture === atlas.texture) this.#useTexture(null);
+            this.gl.deleteTexture(atlas.texture);
+        }
+        this.glyphs.clear();
+    }
+
+    // Printable ASCII in white, laid out in rows
+    #glyphAtlas(family) {
+        let atlas = this.glyphs.get(family);
+        if (atlas !== undefined) return atlas;
+
+        const canvas = createCanvas(GLYPH_ATLAS_WIDTH, 1);
+        const ctx = canvas.getContext("2d");
+        const font = `${GLYPH_ATLAS_FONT_SIZE}px ${family}`;
+        ctx.font = font;
+        const glyphs = [];
+        let x = 0, y = 0, rowHeight = 0;
+        for (let c = 32; c < 127; c++) {
+            const metrics = ctx.measureText(String.fromCharCode(c));
+            const left = Math.ceil(metrics.actualBoundingBoxLeft) + GLYPH_ATLAS_PAD;
+            const ascent = Math.ceil(metrics.actualBoundingBoxAscent) + GLYPH_ATLAS_PAD;
+            const width = left + Math.ceil(metrics.actualBoundingBoxRight) + GLYPH_ATLAS_PAD;
+            const height = ascent + Math.ceil(metrics.actualBoundingBoxDescent) + GLYPH_ATLAS_PAD;
+            if (x + width > GLYPH_ATLAS_WIDTH) {
+                x = 0;
+                y += rowHeight;
+                rowHeight = 0;
+            }
+            glyphs[c] = {x, y, width, height, left, ascent, advance: metrics.width};
+            x += width;
+            rowHeight = Math.max(rowHeight, height);
+        }
+        // How far textBaseline "top" is above the alphabetic baseline
+        const ascent = ctx.measureText("M").actualBoundingBoxAscent;
+        ctx.textBaseline = "top";
+        const top = ascent - ctx.measureText("M").actualBoundingBoxAscent;
+
+        canvas.width = GLYPH_ATLAS_WIDTH;
+        canvas.height = y + rowHeight;
+        ctx.font = font;
+        ctx.fillStyle = "white";
+        for (let c = 32; c < 127; c++) {
+            const glyph = glyphs[c];
+            ctx.fillText(String.fromCharCode(c), glyph.x + glyph.left, glyph.y + glyph.ascent);
+        }
+
+        const gl = this.gl;
+        const texture = this.#texture(canvas.width, canvas.height, canvas);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.LINEAR_MIPMAP_LINEAR);
+        gl.generateMipmap(gl.TEXTURE_2D);
+
+        atlas = {texture, width: canvas.width, height: canvas.height, glyphs, top};
+        this.glyphs.set(family, atlas);
+        return atlas;
+    }
+}
+
 const glfwMouseButtonMapping = {
     0: 0, // MOUSE_BUTTON_LEFT
     2: 1, // MOUSE_BUTTON_RIGHT
@@ -762,24 +1740,53 @@ const glfwKeyMapping = {
     //  GLFW_KEY_LAST   GLFW_KEY_MENU
 }
 
-function degreesToRadians(degrees) {
-    return (degrees % 360) * (Math.PI / 180);
+// An element on the page, an OffscreenCanvas in a worker
+function createCanvas(width, height) {
+    if (typeof document === "undefined") return new OffscreenCanvas(width, height);
+    const canvas = document.createElement("canvas");
+    canvas.width = width;
+    canvas.height = height;
+    return canvas;
 }
 
-function cstrlen(mem, ptr) {
-    let len = 0;
-    while (mem[ptr] != 0) {
-        len++;
-        ptr++;
+function fontFaceSet() {
+    return typeof document !== "undefined" ? document.fonts : self.fonts;
+}
+
+// The @font-face rules of the page with absolute URLs, for the worker to load
+function pageFontFaces() {
+    const faces = [];
+    for (const sheet of document.styleSheets) {
+        let rules;
+        try {
+            rules = sheet.cssRules;
+        } catch {
+            continue; // a stylesheet from another origin
+        }
+        const base = sheet.href ?? document.baseURI;
+        for (const rule of rules) {
+            if (!(rule instanceof CSSFontFaceRule)) continue;
+            const family = rule.style.getPropertyValue("font-family").replace(/^["']|["']$/g, "");
+            const source = rule.style.getPropertyValue("src").replace(/url\(\s*(["']?)(.*?)\1\s*\)/g,
+                (match, quote, url) => `url("${new URL(url, base).href}")`);
+            faces.push({family, source});
+        }
     }
-    return len;
+    return faces;
+}
+
+function degreesToRadians(degrees) {
+    return (degrees % 360) * (Math.PI / 180);
 }
 
-function cstr_by_ptr(mem_buffer, ptr) {
-    const mem = new Uint8Array(mem_buffer);
-    const len = cstrlen(mem, ptr);
-    const bytes = new Uint8Array(mem_buffer, ptr, len);
-    return new TextDecoder().decode(bytes);
+// Camera2D as raylib applies it: around the target, rotated by `rotation`
+// degrees and zoomed, the target ending up at the offset. Returns the zoomed
+// cosine and sine of the rotation and the translation, so a point maps to
+// (cos*x - sin*y + tx, sin*x + cos*y + ty).
+function camera2D(offsetX, offsetY, targetX, targetY, rotation, zoom) {
+    const angle = degreesToRadians(rotation);
+    const cos = Math.cos(angle)*zoom, sin = Math.sin(angle)*zoom;
+    return [cos, sin, offsetX - (cos*targetX - sin*targetY), offsetY - (sin*targetX + cos*targetY)];
 }
 
 function color_hex_unpacked(r, g, b, a) {
@@ -798,7 +1805,16 @@ function color_hex(color) {
     return "#"+r+g+b+a;
 }
 
-function getColorFromMemory(buffer, color_ptr) {
-    const [r, g, b, a] = new Uint8Array(buffer, color_ptr, 4);
-    return color_hex_unpacked(r, g, b, a);
+// Started by RaylibJs.start() with `worker`, this same file runs the game
+if (typeof WorkerGlobalScope !== "undefined" && self instanceof WorkerGlobalScope) {
+    const raylibJs = new RaylibJs();
+    self.onmessage = ({data}) => {
+        if (data.canvas !== undefined) {
+            raylibJs.runInWorker(data);
+        } else if (data.wakeUp) {
+            raylibJs.wakeUp();
+        } else if (data.stop) {
+            raylibJs.stop();
+        }
+    };
 }
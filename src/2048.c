@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include "2048.h"
+#include "trace.h"
 #include <stdlib.h>
 
 #ifndef PLATFORM_WEB
@@ -7,14 +8,93 @@
 #endif // PLATFORM_WEB
 
 
-static int board[ROWS][COLUMNS]          = {0};
-static int back_board[ROWS][COLUMNS]     = {0};
-static int prev_board[ROWS][COLUMNS]     = {0};
-static int movement_board[ROWS][COLUMNS] = {0};
-static int prev_score                    = 0;
-static int score                         = 0;
+static int board[MAX_BOARD_SIZE][MAX_BOARD_SIZE]          = {0};
+static int back_board[MAX_BOARD_SIZE][MAX_BOARD_SIZE]     = {0};
+static int prev_board[MAX_BOARD_SIZE][MAX_BOARD_SIZE]     = {0};
+static int movement_board[MAX_BOARD_SIZE][MAX_BOARD_SIZE] = {0};
+static long long prev_score                               = 0;
+static long long score                                    = 0;
+static int board_size                                     = DEFAULT_BOARD_SIZE;
 
-int get_score(void)
+typedef struct {
+    int board[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    int movement[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    long long score_gain;
+    bool swiped;
+} Successor;
+
+// The boards the current one swipes into, computed ahead of time by
+// precompute_successors() so that a swipe is just a copy. Anything that
+// changes the board invalidates them. The AI does not use them, it searches
+// its own copies of the board on its own thread.
+static Successor successors[DIRECTION_COUNT];
+static bool successors_valid = false;
+
+
+typedef struct {
+    void (*copy_board)(int dst[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int src[MAX_BOARD_SIZE][MAX_BOARD_SIZE]);
+    void (*clear_cells)(int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE]);
+    void (*add_random_cell)(void);
+    void (*rotate_board)(void);
+    bool (*swipe_board)(Direction direction);
+    void (*precompute_successors)(void);
+    void (*apply_successor)(Successor *successor);
+} Board_Ops;
+
+#define OP_CONCAT_(name, size) name##_##size
+#define OP_CONCAT(name, size) OP_CONCAT_(name, size)
+#define OP(name) OP_CONCAT(name, N)
+
+#define N 3
+#include "2048_ops.h"
+#undef N
+#define N 4
+#include "2048_ops.h"
+#undef N
+#define N 5
+#include "2048_ops.h"
+#undef N
+#define N 6
+#include "2048_ops.h"
+#undef N
+#define N 7
+#include "2048_ops.h"
+#undef N
+#define N 8
+#include "2048_ops.h"
+#undef N
+
+static const Board_Ops *board_ops_by_size[MAX_BOARD_SIZE + 1] = {
+    [3] = &board_ops_3,
+    [4] = &board_ops_4,
+    [5] = &board_ops_5,
+    [6] = &board_ops_6,
+    [7] = &board_ops_7,
+    [8] = &board_ops_8,
+};
+
+// Operations of the current board size, picked once in set_board_size()
+static const Board_Ops *ops = &board_ops_4;
+
+
+int get_board_size(void)
+{
+    return board_size;
+}
+
+bool set_board_size(int size)
+{
+    if (size < MIN_BOARD_SIZE || size > MAX_BOARD_SIZE) return false;
+    board_size = size;
+    ops = board_ops_by_size[size];
+    clear_board();
+    save_prev_board();
+    save_back_board();
+    reset_score();
+    return true;
+}
+
+long long get_score(void)
 {
     return score;
 }
@@ -31,6 +111,7 @@ int cell_at(int x, int y) {
 
 void set_cell_at(int x, int y, int value) {
     board[y][x] = value;
+    successors_valid = false;
 }
 
 int movement_at(int x, int y) {
@@ -39,77 +120,44 @@ int movement_at(int x, int y) {
 
 void restore_prev_board(void)
 {
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-        for (int x = 0; x < BOARD_SIZE; ++x) {
-            board[y][x] = prev_board[y][x];
-        }
-    }
+    ops->copy_board(board, prev_board);
+    successors_valid = false;
 }
 
 void save_prev_board(void)
 {
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-        for (int x = 0; x < BOARD_SIZE; ++x) {
-            prev_board[y][x] = board[y][x];
-        }
-    }
+    ops->copy_board(prev_board, board);
 }
 
 void save_back_board(void)
 {
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-        for (int x = 0; x < BOARD_SIZE; ++x) {
-            back_board[y][x] = board[y][x];
-        }
-    }
+    ops->copy_board(back_board, board);
 }
 
 void cancel_move(void)
 {
+    TRACE_SCOPE("cancel_move");
     score = prev_score;
     restore_prev_board();
     save_back_board();
 }
 
 void clear_movement_board(void) {
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-        for (int x = 0; x < BOARD_SIZE; ++x) {
-            movement_board[y][x] = 0;
-        }
-    }
+    ops->clear_cells(movement_board);
 }
 
 void clear_board(void)
 {
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-        for (int x = 0; x < BOARD_SIZE; ++x) {
-            board[y][x] = 0; 
-        }
-    }
+    ops->clear_cells(board);
     clear_movement_board();
+    successors_valid = false;
 }
 
 
 void add_random_cell(void) {
-    bool indexes[BOARD_CAP] = {0};
-    int i = -1;
-    int tryes = 0;
-
-    do {
-        i = rand() % BOARD_CAP;
-        if (!indexes[i]) {
-            ++tryes;
-            indexes[i] = true;
-            if (tryes >= BOARD_CAP) {
-                i = -1;
-                break;
-            } 
-        }
-    } while (board[i/BOARD_SIZE][i%BOARD_SIZE] != 0);
-
-    if (i < 0 || i >= BOARD_CAP) return;
-    int value = rand() % 100 < 90 ? 2 : 4;
-    board[i/BOARD_SIZE][i%BOARD_SIZE] = value;
+    TRACE_SCOPE("add_random_cell");
+    ops->add_random_cell();
+    successors_valid = false;
 }
 
 #ifndef PLATFORM_WEB
@@ -141,93 +189,69 @@ void print_board(void)
 // Rotate the board 90 degrees clockwise
 void rotate_board(void)
 {
-    for (int i = 0; i < BOARD_SIZE/2; ++i) {
-        for (int j = i; j < BOARD_SIZE - i - 1; ++j) {
-            int temp = board[i][j];
-            board[i][j] = board[BOARD_SIZE - 1 - j][i];
-            board[BOARD_SIZE - 1 - j][i] = board[BOARD_SIZE - 1 - i][BOARD_SIZE - 1 - j];
-            board[BOARD_SIZE - 1 - i][BOARD_SIZE - 1 - j] = board[j][BOARD_SIZE - 1 - i];
-            board[j][BOARD_SIZE - 1 - i] = temp;
-
-            int movement_temp = movement_board[i][j];
-            movement_board[i][j] = movement_board[BOARD_SIZE - 1 - j][i];
-            movement_board[BOARD_SIZE - 1 - j][i] = movement_board[BOARD_SIZE - 1 - i][BOARD_SIZE - 1 - j];
-            movement_board[BOARD_SIZE - 1 - i][BOARD_SIZE - 1 - j] = movement_board[j][BOARD_SIZE - 1 - i];
-            movement_board[j][BOARD_SIZE - 1 - i] = movement_temp;
-        } 
+    ops->rotate_board();
+    successors_valid = false;
+}
+
+
+void precompute_successors(void)
+{
+    if (successors_valid) return;
+    TRACE_SCOPE("precompute_successors");
+    ops->precompute_successors();
+    successors_valid = true;
+}
+
+
+bool can_swipe(Direction direction)
+{
+    precompute_successors();
+    return successors[direction].swiped;
+}
+
+
+bool is_game_over(void)
+{
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        if (can_swipe(d)) return false;
     }
+    return true;
 }
 
 
-bool swipe_board_right(void)
+static bool swipe_board_direction(Direction direction)
 {
+    if (!successors_valid) return ops->swipe_board(direction);
+
+    Successor *successor = &successors[direction];
     prev_score = score;
-    clear_movement_board();
-    bool is_board_swiped = false;
-    for (int y = 0; y < ROWS; ++y) {
-        for (int x = COLUMNS - 1; x >= 0; --x) {
-            bool use_value = board[y][x] == 0 ? false : true;
-            int value = board[y][x];
-            int nx = -1;
-            for (int sx = x - 1; sx >= 0; --sx) {
-                if (use_value) {
-                  if (board[y][sx] == value) {
-                      nx = sx; 
-                      break;
-                  } else if (board[y][sx] != 0) {
-                      break;
-                  }
-                } else {
-                  if (board[y][sx] != 0) {
-                      nx = sx;
-                      break;
-                  }
-                }
-            } 
-            if (nx < 0) {
-                continue;
-            }
-            is_board_swiped = true;
-            if (use_value) {
-                board[y][x] += value;
-                score += value*2;
-            } else {
-                board[y][x] = board[y][nx];
-            }
-            movement_board[y][nx] = x - nx;
-            board[y][nx] = 0;
-            if (!use_value) ++x;
-        }
-    }
-    return is_board_swiped;
+    score += successor->score_gain;
+    ops->apply_successor(successor);
+    successors_valid = false;
+    return successor->swiped;
+}
+
+
+bool swipe_board_right(void)
+{
+    TRACE_SCOPE("swipe_board_right");
+    return swipe_board_direction(DIRECTION_RIGHT);
 }
 
 
 bool swipe_board_left(void) {
-    rotate_board(); 
-    rotate_board(); 
-    bool is_board_swiped = swipe_board_right();
-    rotate_board(); 
-    rotate_board(); 
-    return is_board_swiped;
+    TRACE_SCOPE("swipe_board_left");
+    return swipe_board_direction(DIRECTION_LEFT);
 }
 
 
 bool swipe_board_down(void) {
-    rotate_board();
-    rotate_board(); 
-    rotate_board(); 
-    bool is_board_swiped = swipe_board_right();
-    rotate_board(); 
-    return is_board_swiped;
+    TRACE_SCOPE("swipe_board_down");
+    return swipe_board_direction(DIRECTION_DOWN);
 }
 
 
 bool swipe_board_up(void) {
-    rotate_board(); 
-    bool is_board_swiped = swipe_board_right();
-    rotate_board(); 
-    rotate_board(); 
-    rotate_board(); 
-    return is_board_swiped;
+    TRACE_SCOPE("swipe_board_up");
+    return swipe_board_direction(DIRECTION_UP);
 }
@@ -1,25 +1,42 @@
 #ifndef GAME_H_
 #define GAME_H_
 
-#define BOARD_SIZE 4
+#define MIN_BOARD_SIZE 3
+#define MAX_BOARD_SIZE 8
+#define DEFAULT_BOARD_SIZE 4
+#define BOARD_SIZE (get_board_size())
 #define BOARD_CAP (BOARD_SIZE * BOARD_SIZE)
 #define ROWS (BOARD_SIZE)
 #define COLUMNS (BOARD_SIZE)
 
+typedef enum {
+    DIRECTION_LEFT,
+    DIRECTION_DOWN,
+    DIRECTION_RIGHT,
+    DIRECTION_UP,
+    DIRECTION_COUNT,
+} Direction;
+
+int get_board_size(void);
+bool set_board_size(int size);
 int cell_at(int x, int y);
 void set_cell_at(int x, int y, int value);
 int movement_at(int x, int y);
-int get_score(void);
+long long get_score(void);
 void reset_score(void);
 void cancel_move(void);
 void save_back_board(void);
 void save_prev_board(void);
 void clear_board(void);
+void rotate_board(void);
 bool swipe_board_right(void);
 bool swipe_board_left(void);
 bool swipe_board_down(void);
 bool swipe_board_up(void);
 void print_board(void);
 void add_random_cell(void);
+void precompute_successors(void);
+bool can_swipe(Direction direction);
+bool is_game_over(void);
 
 #endif // GAME_H_
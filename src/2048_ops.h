@@ -0,0 +1,200 @@
+// Board operations specialized for one board size.
+//
+// This file is included by 2048.c once per supported size with N defined to
+// the size, so every loop below has compile-time bounds and the functions
+// get the _N suffix (swipe_board_right_4, rotate_board_4, ...).
+// No include guard on purpose.
+
+#ifndef N
+    #error "N has to be defined to the board size before including 2048_ops.h"
+#endif
+
+static void OP(copy_board)(int dst[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int src[MAX_BOARD_SIZE][MAX_BOARD_SIZE])
+{
+    for (int y = 0; y < N; ++y) {
+        for (int x = 0; x < N; ++x) {
+            dst[y][x] = src[y][x];
+        }
+    }
+}
+
+static void OP(clear_cells)(int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE])
+{
+    for (int y = 0; y < N; ++y) {
+        for (int x = 0; x < N; ++x) {
+            cells[y][x] = 0;
+        }
+    }
+}
+
+static void OP(add_random_cell)(void)
+{
+    // Zeroed in a loop, the web build has no memset for `= {0}` on bigger arrays
+    bool indexes[N*N];
+    for (int j = 0; j < N*N; ++j) indexes[j] = false;
+    int i = -1;
+    int tryes = 0;
+
+    do {
+        i = rand() % (N*N);
+        if (!indexes[i]) {
+            ++tryes;
+            indexes[i] = true;
+            if (tryes >= N*N) {
+                i = -1;
+                break;
+            }
+        }
+    } while (board[i/N][i%N] != 0);
+
+    if (i < 0 || i >= N*N) return;
+    int value = rand() % 100 < 90 ? 2 : 4;
+    board[i/N][i%N] = value;
+}
+
+// Rotate the board 90 degrees clockwise
+static void OP(rotate_board)(void)
+{
+    for (int i = 0; i < N/2; ++i) {
+        for (int j = i; j < N - i - 1; ++j) {
+            int temp = board[i][j];
+            board[i][j] = board[N - 1 - j][i];
+            board[N - 1 - j][i] = board[N - 1 - i][N - 1 - j];
+            board[N - 1 - i][N - 1 - j] = board[j][N - 1 - i];
+            board[j][N - 1 - i] = temp;
+
+            int movement_temp = movement_board[i][j];
+            movement_board[i][j] = movement_board[N - 1 - j][i];
+            movement_board[N - 1 - j][i] = movement_board[N - 1 - i][N - 1 - j];
+            movement_board[N - 1 - i][N - 1 - j] = movement_board[j][N - 1 - i];
+            movement_board[j][N - 1 - i] = movement_temp;
+        }
+    }
+}
+
+static bool OP(swipe_board_right)(void)
+{
+    prev_score = score;
+    OP(clear_cells)(movement_board);
+    bool is_board_swiped = false;
+    for (int y = 0; y < N; ++y) {
+        for (int x = N - 1; x >= 0; --x) {
+            bool use_value = board[y][x] == 0 ? false : true;
+            int value = board[y][x];
+            int nx = -1;
+            for (int sx = x - 1; sx >= 0; --sx) {
+                if (use_value) {
+                  if (board[y][sx] == value) {
+                      nx = sx;
+                      break;
+                  } else if (board[y][sx] != 0) {
+                      break;
+                  }
+                } else {
+                  if (board[y][sx] != 0) {
+                      nx = sx;
+                      break;
+                  }
+                }
+            }
+            if (nx < 0) {
+                continue;
+            }
+            is_board_swiped = true;
+            if (use_value) {
+                board[y][x] += value;
+                score += (long long)value*2;
+            } else {
+                board[y][x] = board[y][nx];
+            }
+            movement_board[y][nx] = x - nx;
+            board[y][nx] = 0;
+            if (!use_value) ++x;
+        }
+    }
+    return is_board_swiped;
+}
+
+static bool OP(swipe_board_left)(void)
+{
+    OP(rotate_board)();
+    OP(rotate_board)();
+    bool is_board_swiped = OP(swipe_board_right)();
+    OP(rotate_board)();
+    OP(rotate_board)();
+    return is_board_swiped;
+}
+
+static bool OP(swipe_board_down)(void)
+{
+    OP(rotate_board)();
+    OP(rotate_board)();
+    OP(rotate_board)();
+    bool is_board_swiped = OP(swipe_board_right)();
+    OP(rotate_board)();
+    return is_board_swiped;
+}
+
+static bool OP(swipe_board_up)(void)
+{
+    OP(rotate_board)();
+    bool is_board_swiped = OP(swipe_board_right)();
+    OP(rotate_board)();
+    OP(rotate_board)();
+    OP(rotate_board)();
+    return is_board_swiped;
+}
+
+static bool OP(swipe_board)(Direction direction)
+{
+    switch (direction) {
+        case DIRECTION_LEFT:  return OP(swipe_board_left)();
+        case DIRECTION_DOWN:  return OP(swipe_board_down)();
+        case DIRECTION_RIGHT: return OP(swipe_board_right)();
+        case DIRECTION_UP:    return OP(swipe_board_up)();
+        default:              return false;
+    }
+}
+
+// Runs ahead of every move of the game, so the copies and swipes in here
+// are direct calls rather than going through the ops table
+static void OP(precompute_successors)(void)
+{
+    static int saved_board[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    static int saved_movement_board[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    long long saved_score = score;
+    long long saved_prev_score = prev_score;
+    OP(copy_board)(saved_board, board);
+    OP(copy_board)(saved_movement_board, movement_board);
+
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        Successor *successor = &successors[d];
+        OP(copy_board)(board, saved_board);
+        score = saved_score;
+        successor->swiped = OP(swipe_board)(d);
+        successor->score_gain = score - saved_score;
+        OP(copy_board)(successor->board, board);
+        OP(copy_board)(successor->movement, movement_board);
+    }
+
+    OP(copy_board)(board, saved_board);
+    OP(copy_board)(movement_board, saved_movement_board);
+    score = saved_score;
+    prev_score = saved_prev_score;
+}
+
+static void OP(apply_successor)(Successor *successor)
+{
+    OP(copy_board)(board, successor->board);
+    OP(copy_board)(movement_board, successor->movement);
+}
+
+static const Board_Ops OP(board_ops) = {
+    .copy_board            = OP(copy_board),
+    .clear_cells           = OP(clear_cells),
+    .add_random_cell       = OP(add_random_cell),
+    .rotate_board          = OP(rotate_board),
+    .swipe_board           = OP(swipe_board),
+    .precompute_successors = OP(precompute_successors),
+    .apply_successor       = OP(apply_successor),
+};
@@ -0,0 +1,517 @@
+#include <stdatomic.h>
+#include "raylib.h"
+#include "ai.h"
+#include "trace.h"
+
+#ifndef PLATFORM_WEB
+    #include <pthread.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+#endif
+
+#define AI_CHECK_NODES 1024           // nodes between two checks for cancellation
+#define AI_MIN_PROBABILITY 0.001      // less likely chance nodes are only evaluated
+#define AI_SLICE_TIME 0.004           // seconds of search per ai_update() on the web
+
+#define EMPTY_WEIGHT 270.0
+#define MERGE_WEIGHT 700.0
+#define MONOTONICITY_WEIGHT 47.0
+#define GAME_OVER_VALUE -1000000.0
+
+// Cells hold exponents, 0 is empty
+typedef struct {
+    int size;
+    unsigned char cells[MAX_BOARD_SIZE*MAX_BOARD_SIZE];
+} Ai_Board;
+
+typedef struct {
+    bool cancellable; // stopped by a newer ai_search()
+    unsigned int generation;
+    double deadline;  // GetTime() to stop at, 0 for no deadline
+    long long nodes;
+    bool aborted;
+} Search;
+
+// Only increments, a search whose generation is not the latest one is stale
+static atomic_uint generation = 0;
+
+static Ai_Board request = {0};
+static Ai_Result result = {0};
+
+#ifdef PLATFORM_WEB
+// The iteration in progress, resumed on every ai_update()
+static unsigned int sliced_generation = 0;
+static int sliced_depth = 0;
+static int sliced_direction = 0;
+static bool sliced_can_move[DIRECTION_COUNT];
+static double sliced_value[DIRECTION_COUNT];
+#else
+static pthread_t thread;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t request_ready = PTHREAD_COND_INITIALIZER;
+static unsigned int searched_generation = 0;
+static bool quit = false;
+#endif
+
+
+// Copied by hand, the web build has no memcpy for bigger struct copies
+static void copy_board(Ai_Board *dst, const Ai_Board *src)
+{
+    dst->size = src->size;
+    for (int i = 0; i < src->size*src->size; ++i) dst->cells[i] = src->cells[i];
+}
+
+
+static void copy_result(Ai_Result *dst, const Ai_Result *src)
+{
+    dst->depth = src->depth;
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        dst->can_move[d] = src->can_move[d];
+        dst->value[d] = src->value[d];
+    }
+    dst->best = src->best;
+    dst->nodes = src->nodes;
+    dst->done = src->done;
+}
+
+
+// Index of the k-th cell of a line, counted from the edge the tiles move to
+static int line_index(int size, int direction, int line, int k)
+{
+    switch (direction) {
+        case DIRECTION_LEFT:  return line*size + k;
+        case DIRECTION_RIGHT: return line*size + size - 1 - k;
+        case DIRECTION_UP:    return k*size + line;
+        case DIRECTION_DOWN:  return (size - 1 - k)*size + line;
+        default:              return 0;
+    }
+}
+
+
+static bool move_board(const Ai_Board *from, int direction, Ai_Board *to, double *gain)
+{
+    int size = from->size;
+    bool moved = false;
+    *gain = 0.0;
+    to->size = size;
+
+    for (int line = 0; line < size; ++line) {
+        int out[MAX_BOARD_SIZE];
+        bool merged[MAX_BOARD_SIZE];
+        int count = 0;
+        for (int k = 0; k < size; ++k) {
+            int exponent = from->cells[line_index(size, direction, line, k)];
+            if (exponent == 0) continue;
+            if (count > 0 && out[count - 1] == exponent && !merged[count - 1]) {
+                out[count - 1]++;
+                merged[count - 1] = true;
+                *gain += (double)(1ll << (exponent + 1));
+            } else {
+                out[count] = exponent;
+                merged[count] = false;
+                count++;
+            }
+        }
+        for (int k = 0; k < size; ++k) {
+            int i = line_index(size, direction, line, k);
+            int exponent = k < count ? out[k] : 0;
+            if (exponent != from->cells[i]) moved = true;
+            to->cells[i] = exponent;
+        }
+    }
+    return moved;
+}
+
+
+// Prefers empty cells, neighbours that can merge and rows and columns that
+// only grow in one direction
+static double evaluate(const Ai_Board *board)
+{
+    int size = board->size;
+    double empty = 0.0;
+    double merges = 0.0;
+    double monotonicity = 0.0;
+
+    for (int i = 0; i < size*size; ++i) {
+        if (board->cells[i] == 0) empty += 1.0;
+    }
+
+    for (int direction = DIRECTION_LEFT; direction <= DIRECTION_DOWN; ++direction) {
+        for (int line = 0; line < size; ++line) {
+            double increasing = 0.0;
+            double decreasing = 0.0;
+            for (int k = 0; k + 1 < size; ++k) {
+                int a = board->cells[line_index(size, direction, line, k)];
+                int b = board->cells[line_index(size, direction, line, k + 1)];
+                if (a != 0 && a == b) merges += 1.0;
+                if (a > b) {
+                    decreasing += a*a - b*b;
+                } else {
+                    increasing += b*b - a*a;
+                }
+            }
+            monotonicity -= increasing < decreasing ? increasing : decreasing;
+        }
+    }
+
+    return EMPTY_WEIGHT*empty + MERGE_WEIGHT*merges + MONOTONICITY_WEIGHT*monotonicity;
+}
+
+
+static bool search_stopped(Search *search)
+{
+    if (search->aborted) return true;
+    if ((++search->nodes % AI_CHECK_NODES) != 0) return false;
+
+    if (search->cancellable && atomic_load_explicit(&generation, memory_order_relaxed) != search->generation) {
+        search->aborted = true;
+    }
+    if (search->deadline > 0.0 && GetTime() > search->deadline) search->aborted = true;
+    return search->aborted;
+}
+
+
+static double chance_node(const Ai_Board *board, int depth, double probability, Search *search);
+
+
+static double max_node(const Ai_Board *board, int depth, double probability, Search *search)
+{
+    if (depth == 0 || probability < AI_MIN_PROBABILITY) return evaluate(board);
+
+    double best = GAME_OVER_VALUE;
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        Ai_Board child;
+        double gain;
+        if (!move_board(board, d, &child, &gain)) continue;
+        double value = gain + chance_node(&child, depth - 1, probability, search);
+        if (value > best) best = value;
+        if (search->aborted) return 0.0;
+    }
+    return best;
+}
+
+
+static double chance_node(const Ai_Board *board, int depth, double probability, Search *search)
+{
+    if (search_stopped(search)) return 0.0;
+
+    int size = board->size;
+    int empty = 0;
+    for (int i = 0; i < size*size; ++i) {
+        if (board->cells[i] == 0) ++empty;
+    }
+    if (empty == 0) return max_node(board, depth, probability, search);
+
+    Ai_Board child;
+    copy_board(&child, board);
+    double total = 0.0;
+    for (int i = 0; i < size*size; ++i) {
+        if (board->cells[i] != 0) continue;
+        child.cells[i] = 1;
+        total += 0.9*max_node(&child, depth, probability*0.9/empty, search);
+        child.cells[i] = 2;
+        total += 0.1*max_node(&child, depth, probability*0.1/empty, search);
+        child.cells[i] = 0;
+        if (search->aborted) return 0.0;
+    }
+    return total/empty;
+}
+
+
+// Value of one move at the root, `depth` counts the moves including this one
+static double root_value(const Ai_Board *board, int direction, int depth, bool *can_move, Search *search)
+{
+    Ai_Board child;
+    double gain;
+    *can_move = move_board(board, direction, &child, &gain);
+    if (!*can_move) return GAME_OVER_VALUE;
+    return gain + chance_node(&child, depth - 1, 1.0, search);
+}
+
+
+// Publishes a finished iteration unless the board changed in the meantime
+static void publish(unsigned int search_generation, int depth, const bool *can_move, const double *value,
+                    long long nodes, bool done)
+{
+    if (atomic_load(&generation) != search_generation) return;
+
+    Ai_Result iteration;
+    iteration.depth = depth;
+    iteration.best = -1;
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        iteration.can_move[d] = can_move[d];
+        iteration.value[d] = value[d];
+        if (can_move[d] && (iteration.best < 0 || value[d] > value[iteration.best])) iteration.best = d;
+    }
+    iteration.nodes = nodes;
+    iteration.done = done || iteration.best < 0;
+
+#ifndef PLATFORM_WEB
+    pthread_mutex_lock(&mutex);
+#endif
+    // Checked again under the lock: ai_search() clears the result and bumps
+    // the generation under it, a stale iteration must not land on top of that
+    if (atomic_load(&generation) == search_generation) copy_result(&result, &iteration);
+#ifndef PLATFORM_WEB
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+
+void ai_result(Ai_Result *out)
+{
+#ifndef PLATFORM_WEB
+    pthread_mutex_lock(&mutex);
+#endif
+    copy_result(out, &result);
+#ifndef PLATFORM_WEB
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+
+static bool same_board(const Ai_Board *board, const int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int size)
+{
+    if (board->size != size) return false;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            int exponent = 0;
+            for (int value = cells[y][x]; value > 1; value >>= 1) ++exponent;
+            if (board->cells[y*size + x] != exponent) return false;
+        }
+    }
+    return true;
+}
+
+
+static void board_from_cells(Ai_Board *board, const int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int size)
+{
+    board->size = size;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            int exponent = 0;
+            for (int value = cells[y][x]; value > 1; value >>= 1) ++exponent;
+            board->cells[y*size + x] = exponent;
+        }
+    }
+}
+
+
+int ai_choose_move(const int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int size, int min_depth, double deadline, int *depth)
+{
+    TRACE_SCOPE("ai_choose_move");
+    Ai_Board board;
+    board_from_cells(&board, cells, size);
+
+    int best = -1;
+    *depth = 0;
+    for (int iteration = 1; iteration <= AI_MAX_DEPTH; ++iteration) {
+        Search search = {.deadline = iteration <= min_depth ? 0.0 : deadline};
+        int iteration_best = -1;
+        double best_value = 0.0;
+        for (int d = 0; d < DIRECTION_COUNT; ++d) {
+            bool can_move;
+            double value = root_value(&board, d, iteration, &can_move, &search);
+            if (search.aborted) return best;
+            if (can_move && (iteration_best < 0 || value > best_value)) {
+                iteration_best = d;
+                best_value = value;
+            }
+        }
+        best = iteration_best;
+        *depth = iteration;
+        if (best < 0 || (iteration >= min_depth && GetTime() > deadline)) break;
+    }
+    return best;
+}
+
+
+int ai_quick_move(const unsigned char *cells, int size)
+{
+    Ai_Board board;
+    board.size = size;
+    for (int i = 0; i < size*size; ++i) board.cells[i] = cells[i];
+
+    Search search = {0};
+    int best = -1;
+    double best_value = 0.0;
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        bool can_move;
+        double value = root_value(&board, d, 1, &can_move, &search);
+        if (can_move && (best < 0 || value > best_value)) {
+            best = d;
+            best_value = value;
+        }
+    }
+    return best;
+}
+
+
+bool ai_swipe(unsigned char *cells, int size, Direction direction, long long *gain)
+{
+    Ai_Board from;
+    Ai_Board to;
+    from.size = size;
+    for (int i = 0; i < size*size; ++i) from.cells[i] = cells[i];
+
+    double board_gain;
+    if (!move_board(&from, direction, &to, &board_gain)) return false;
+    for (int i = 0; i < size*size; ++i) cells[i] = to.cells[i];
+    *gain = (long long)board_gain;
+    return true;
+}
+
+
+static void clear_result(void)
+{
+    result.depth = 0;
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        result.can_move[d] = false;
+        result.value[d] = 0.0;
+    }
+    result.best = -1;
+    result.nodes = 0;
+    result.done = false;
+}
+
+
+#ifdef PLATFORM_WEB
+
+void ai_start(void)
+{
+}
+
+
+void ai_stop(void)
+{
+}
+
+
+void ai_search(const int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int size)
+{
+    if (same_board(&request, cells, size)) return;
+    board_from_cells(&request, cells, size);
+    clear_result();
+    sliced_generation = atomic_fetch_add(&generation, 1) + 1;
+    sliced_depth = 1;
+    sliced_direction = 0;
+}
+
+
+// Every slice evaluates root moves until its time is up. A root move that does
+// not fit into a whole slice is never going to, so deepening stops there. Depth 1
+// runs past the slice instead, there is no hint to show until it is done.
+void ai_update(void)
+{
+    if (sliced_depth == 0 || result.done) return;
+    TRACE_SCOPE("ai_update");
+
+    double deadline = GetTime() + AI_SLICE_TIME;
+    Search search = {
+        .cancellable = true,
+        .generation = sliced_generation,
+    };
+    bool first = true;
+    while (sliced_depth <= AI_MAX_DEPTH) {
+        search.deadline = sliced_depth == 1 ? 0.0 : deadline;
+        long long nodes = search.nodes;
+        double value = root_value(&request, sliced_direction, sliced_depth, &sliced_can_move[sliced_direction], &search);
+        if (search.aborted) {
+            if (first) result.done = true;
+            return;
+        }
+        first = false;
+        result.nodes += search.nodes - nodes;
+        sliced_value[sliced_direction] = value;
+
+        if (++sliced_direction == DIRECTION_COUNT) {
+            publish(sliced_generation, sliced_depth, sliced_can_move, sliced_value, result.nodes, sliced_depth == AI_MAX_DEPTH);
+            sliced_direction = 0;
+            sliced_depth++;
+            if (result.done) return;
+        }
+    }
+}
+
+#else
+
+static void run_search(const Ai_Board *board, unsigned int search_generation)
+{
+    Search search = {.cancellable = true, .generation = search_generation};
+    bool can_move[DIRECTION_COUNT];
+    double value[DIRECTION_COUNT];
+
+    for (int depth = 1; depth <= AI_MAX_DEPTH; ++depth) {
+        TRACE_SCOPE("ai_iteration");
+        for (int d = 0; d < DIRECTION_COUNT; ++d) {
+            value[d] = root_value(board, d, depth, &can_move[d], &search);
+            if (search.aborted) return;
+        }
+        publish(search_generation, depth, can_move, value, search.nodes, depth == AI_MAX_DEPTH);
+    }
+}
+
+
+static void *ai_thread(void *arg)
+{
+    (void)arg;
+    TRACE_THREAD_NAME("ai");
+    for (;;) {
+        pthread_mutex_lock(&mutex);
+        while (!quit && atomic_load(&generation) == searched_generation) {
+            pthread_cond_wait(&request_ready, &mutex);
+        }
+        if (quit) {
+            pthread_mutex_unlock(&mutex);
+            TRACE_THREAD_EXIT();
+            return NULL;
+        }
+        // The request only changes under the mutex, together with the generation
+        Ai_Board board;
+        copy_board(&board, &request);
+        searched_generation = atomic_load(&generation);
+        pthread_mutex_unlock(&mutex);
+
+        run_search(&board, searched_generation);
+    }
+}
+
+
+void ai_start(void)
+{
+    if (pthread_create(&thread, NULL, ai_thread, NULL) != 0) {
+        fprintf(stderr, "ERROR: could not start the AI thread\n");
+        exit(1);
+    }
+}
+
+
+void ai_stop(void)
+{
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    atomic_fetch_add(&generation, 1);
+    pthread_cond_signal(&request_ready);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+}
+
+
+void ai_search(const int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int size)
+{
+    pthread_mutex_lock(&mutex);
+    if (!same_board(&request, cells, size)) {
+        board_from_cells(&request, cells, size);
+        clear_result();
+        atomic_fetch_add(&generation, 1);
+        pthread_cond_signal(&request_ready);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+
+void ai_update(void)
+{
+}
+
+#endif // PLATFORM_WEB
@@ -0,0 +1,41 @@
+#ifndef AI_H_
+#define AI_H_
+
+#include <stdbool.h>
+#include "2048.h"
+
+// Iterative deepening expectimax over a copy of the board. Natively the
+// search runs on a worker thread, the web build has no threads and runs it
+// in time slices from ai_update() instead. A new ai_search() cancels the
+// search of the previous board.
+
+#define AI_MAX_DEPTH 6
+
+typedef struct {
+    int depth;                        // deepest finished iteration, 0 before the first one
+    bool can_move[DIRECTION_COUNT];
+    double value[DIRECTION_COUNT];    // expected score gain plus the evaluation of the leaves
+    int best;                         // a Direction, -1 when there is no move
+    long long nodes;
+    bool done;                        // no deeper iteration is coming
+} Ai_Result;
+
+void ai_start(void);
+void ai_stop(void);
+void ai_search(const int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int size);
+// Runs a slice of the search on the calling thread, does nothing when it has its own thread
+void ai_update(void);
+void ai_result(Ai_Result *result);
+// Searches on the calling thread, at least `min_depth` moves deep and deeper
+// until `deadline` (GetTime()). Returns the best Direction or -1 when there is
+// no move, `depth` is the deepest finished iteration.
+int ai_choose_move(const int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE], int size, int min_depth, double deadline, int *depth);
+
+// For games played outside of the engine. `cells` holds size*size exponents
+// row by row, 0 is empty.
+// Searches one move deep, cheap enough to play hundreds of games at once
+int ai_quick_move(const unsigned char *cells, int size);
+// Returns false and leaves the cells alone when the board can not move that way
+bool ai_swipe(unsigned char *cells, int size, Direction direction, long long *gain);
+
+#endif // AI_H_
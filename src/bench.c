@@ -0,0 +1,398 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "2048.h"
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// Microbenchmarks of the engine hot paths.
+//
+// The boards are sampled from games played by a simple corner strategy, so
+// the operations run over the same kind of boards they see in real games.
+// Every operation is timed as "load a sampled board + operation" minus
+// "load a sampled board" (the best of RUNS runs each), the result is
+// written as CSV and optionally compared against a baseline CSV written by
+// an earlier run. Operations that cost less than loading a board run a
+// batch of times per loaded board, so the loading does not drown them out.
+
+#define MAX_SAMPLES 65536
+#define DEFAULT_GAMES 32
+#define DEFAULT_REPEATS 20
+#define DEFAULT_THRESHOLD 10.0
+#define RUNS 5
+
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_CACHE_MISSES,
+    COUNTER_COUNT,
+} Counter;
+
+static const char *counter_names[COUNTER_COUNT] = {
+    [COUNTER_CYCLES]        = "cycles",
+    [COUNTER_INSTRUCTIONS]  = "instructions",
+    [COUNTER_BRANCH_MISSES] = "branch_misses",
+    [COUNTER_CACHE_MISSES]  = "cache_misses",
+};
+
+typedef struct {
+    int fds[COUNTER_COUNT];
+    bool available;
+} Counters;
+
+typedef struct {
+    double ns;
+    long long counts[COUNTER_COUNT];
+} Measurement;
+
+typedef struct {
+    const char *name;
+    double ns_per_op;
+    double ops_per_sec;
+    double per_op[COUNTER_COUNT]; // negative if the counter is not available
+} Result;
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    int batch; // runs per loaded board, only for operations that can repeat on their own result
+} Operation;
+
+static int samples[MAX_SAMPLES][MAX_BOARD_SIZE*MAX_BOARD_SIZE];
+static int sample_count = 0;
+static volatile int sink = 0;
+
+
+static void op_nothing(void) {}
+static void op_swipe_board_right(void) { sink += swipe_board_right(); }
+static void op_swipe_board_up(void) { sink += swipe_board_up(); }
+static void op_rotate_board(void) { rotate_board(); }
+static void op_add_random_cell(void) { add_random_cell(); }
+static void op_save_prev_board(void) { save_prev_board(); }
+static void op_precompute_successors(void) { precompute_successors(); }
+
+// A repeated swipe would mostly find nothing to move, a repeated
+// add_random_cell() a fuller board and a repeated precompute_successors()
+// its own cache, so those run once per board
+static const Operation operations[] = {
+    {"swipe_board_right",     op_swipe_board_right,     1},
+    {"swipe_board_up",        op_swipe_board_up,        1},
+    {"rotate_board",          op_rotate_board,          64},
+    {"add_random_cell",       op_add_random_cell,       1},
+    {"save_prev_board",       op_save_prev_board,       64},
+    {"precompute_successors", op_precompute_successors, 1},
+};
+#define OPERATION_COUNT (sizeof(operations)/sizeof(operations[0]))
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+
+static void counters_open(Counters *c)
+{
+    c->available = false;
+    for (int i = 0; i < COUNTER_COUNT; ++i) c->fds[i] = -1;
+#ifdef __linux__
+    static const unsigned long long configs[COUNTER_COUNT] = {
+        [COUNTER_CYCLES]        = PERF_COUNT_HW_CPU_CYCLES,
+        [COUNTER_INSTRUCTIONS]  = PERF_COUNT_HW_INSTRUCTIONS,
+        [COUNTER_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+        [COUNTER_CACHE_MISSES]  = PERF_COUNT_HW_CACHE_MISSES,
+    };
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        struct perf_event_attr attr = {0};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        c->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (c->fds[i] >= 0) c->available = true;
+    }
+#endif
+}
+
+
+static void counters_start(Counters *c)
+{
+#ifdef __linux__
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (c->fds[i] < 0) continue;
+        ioctl(c->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(c->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)c;
+#endif
+}
+
+
+static void counters_stop(Counters *c, long long *counts)
+{
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        counts[i] = -1;
+#ifdef __linux__
+        if (c->fds[i] < 0) continue;
+        ioctl(c->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        long long value;
+        if (read(c->fds[i], &value, sizeof(value)) == sizeof(value)) counts[i] = value;
+#endif
+    }
+}
+
+
+static void save_sample(void)
+{
+    if (sample_count >= MAX_SAMPLES) return;
+    save_back_board();
+    for (int y = 0; y < ROWS; ++y) {
+        for (int x = 0; x < COLUMNS; ++x) {
+            samples[sample_count][y*COLUMNS + x] = cell_at(x, y);
+        }
+    }
+    ++sample_count;
+}
+
+
+static void load_sample(int i)
+{
+    for (int y = 0; y < ROWS; ++y) {
+        for (int x = 0; x < COLUMNS; ++x) {
+            set_cell_at(x, y, samples[i][y*COLUMNS + x]);
+        }
+    }
+}
+
+
+// Keep the biggest tiles in the bottom right corner, like people do
+static bool play_move(void)
+{
+    if (rand() % 10 == 0) {
+        switch (rand() % 4) {
+            case 0: if (swipe_board_left()) return true; break;
+            case 1: if (swipe_board_up()) return true; break;
+            default: break;
+        }
+    }
+    return swipe_board_down() || swipe_board_right() || swipe_board_left() || swipe_board_up();
+}
+
+
+static void collect_samples(int games)
+{
+    for (int game = 0; game < games && sample_count < MAX_SAMPLES; ++game) {
+        clear_board();
+        reset_score();
+        add_random_cell();
+        save_sample();
+        while (play_move() && sample_count < MAX_SAMPLES) {
+            add_random_cell();
+            save_sample();
+        }
+    }
+}
+
+
+static Measurement measure(void (*run)(void), int batch, Counters *counters, int repeats)
+{
+    Measurement m;
+    counters_start(counters);
+    double start = now_ns();
+    for (int r = 0; r < repeats; ++r) {
+        for (int i = 0; i < sample_count; ++i) {
+            load_sample(i);
+            for (int b = 0; b < batch; ++b) run();
+        }
+    }
+    m.ns = now_ns() - start;
+    counters_stop(counters, m.counts);
+    return m;
+}
+
+
+// Returns false when the operation does not take measurably longer than
+// the loading around it
+static bool run_operation(const Operation *op, Counters *counters, int repeats, Result *out)
+{
+    // The load-only loop calls an empty function as often, so the calls
+    // themselves are not counted either
+    measure(op->run, op->batch, counters, 1); // warm up
+    Measurement base = measure(op_nothing, op->batch, counters, repeats);
+    Measurement full = measure(op->run, op->batch, counters, repeats);
+    for (int run = 1; run < RUNS; ++run) {
+        Measurement m = measure(op_nothing, op->batch, counters, repeats);
+        if (m.ns < base.ns) base = m;
+        m = measure(op->run, op->batch, counters, repeats);
+        if (m.ns < full.ns) full = m;
+    }
+
+    double ops = (double)repeats*sample_count*op->batch;
+    if (full.ns <= base.ns) {
+        fprintf(stderr, "ERROR: %s is not measurably slower than loading a board, give it a bigger batch\n", op->name);
+        return false;
+    }
+    Result result = {0};
+    result.name = op->name;
+    result.ns_per_op = (full.ns - base.ns)/ops;
+    result.ops_per_sec = 1e9/result.ns_per_op;
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (full.counts[i] < 0 || base.counts[i] < 0) {
+            result.per_op[i] = -1;
+        } else {
+            result.per_op[i] = (full.counts[i] - base.counts[i])/ops;
+        }
+    }
+    *out = result;
+    return true;
+}
+
+
+static bool write_results(const char *path, const Result *results, size_t count)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: could not open %s for writing\n", path);
+        return false;
+    }
+    fprintf(f, "name,ns_per_op,ops_per_sec");
+    for (int i = 0; i < COUNTER_COUNT; ++i) fprintf(f, ",%s", counter_names[i]);
+    fprintf(f, "\n");
+    for (size_t r = 0; r < count; ++r) {
+        fprintf(f, "%s,%.3f,%.0f", results[r].name, results[r].ns_per_op, results[r].ops_per_sec);
+        for (int i = 0; i < COUNTER_COUNT; ++i) fprintf(f, ",%.3f", results[r].per_op[i]);
+        fprintf(f, "\n");
+    }
+    if (fclose(f) != 0) {
+        fprintf(stderr, "ERROR: could not write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+
+// Returns the number of operations that got slower than the threshold
+static int compare_with_baseline(const char *path, const Result *results, size_t count, double threshold)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: could not open baseline %s\n", path);
+        return -1;
+    }
+
+    int regressions = 0;
+    char line[512];
+    printf("\n%-24s %12s %12s %9s\n", "baseline", "ns/op", "was", "change");
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[64];
+        double ns_per_op;
+        if (sscanf(line, "%63[^,],%lf", name, &ns_per_op) != 2) continue;
+        for (size_t r = 0; r < count; ++r) {
+            if (strcmp(results[r].name, name) != 0) continue;
+            double change = ns_per_op > 0 ? (results[r].ns_per_op - ns_per_op)/ns_per_op*100.0 : 0.0;
+            bool regressed = change > threshold;
+            if (regressed) ++regressions;
+            printf("%-24s %12.3f %12.3f %+8.1f%%%s\n", name, results[r].ns_per_op, ns_per_op, change,
+                   regressed ? "  REGRESSION" : "");
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-size <%d..%d>] [-games <n>] [-repeats <n>] [-o <results.csv>]\n",
+            program, MIN_BOARD_SIZE, MAX_BOARD_SIZE);
+    fprintf(stderr, "       [-baseline <baseline.csv>] [-threshold <percent>]\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    int games = DEFAULT_GAMES;
+    int repeats = DEFAULT_REPEATS;
+    double threshold = DEFAULT_THRESHOLD;
+    const char *output_path = "bench.csv";
+    const char *baseline_path = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-size") == 0) {
+            if (!set_board_size(atoi(argv[++i]))) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-games") == 0) {
+            games = atoi(argv[++i]);
+            if (games < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-repeats") == 0) {
+            repeats = atoi(argv[++i]);
+            if (repeats < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "-baseline") == 0) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "-threshold") == 0) {
+            threshold = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    srand(69);
+    collect_samples(games);
+    printf("INFO: %d boards sampled from %d games on %dx%d\n", sample_count, games, ROWS, COLUMNS);
+
+    Counters counters;
+    counters_open(&counters);
+    if (!counters.available) printf("INFO: hardware counters are not available\n");
+
+    Result results[OPERATION_COUNT];
+    printf("\n%-24s %12s %14s", "operation", "ns/op", "ops/sec");
+    if (counters.available) {
+        for (int i = 0; i < COUNTER_COUNT; ++i) printf(" %14s", counter_names[i]);
+    }
+    printf("\n");
+    for (size_t r = 0; r < OPERATION_COUNT; ++r) {
+        if (!run_operation(&operations[r], &counters, repeats, &results[r])) return 1;
+        printf("%-24s %12.3f %14.0f", results[r].name, results[r].ns_per_op, results[r].ops_per_sec);
+        if (counters.available) {
+            for (int i = 0; i < COUNTER_COUNT; ++i) printf(" %14.2f", results[r].per_op[i]);
+        }
+        printf("\n");
+    }
+
+    if (!write_results(output_path, results, OPERATION_COUNT)) return 1;
+    printf("\nINFO: results written to %s\n", output_path);
+
+    if (baseline_path != NULL) {
+        int regressions = compare_with_baseline(baseline_path, results, OPERATION_COUNT, threshold);
+        if (regressions != 0) return 1;
+    }
+    return 0;
+}
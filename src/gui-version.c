@@ -2,8 +2,16 @@
 #include <stddef.h>
 #include <math.h>
 #include "raylib.h"
+// Compiled into the program, otherwise the unoptimized web build leaves
+// calls to Lerp() and friends for raylib.js to provide
+#define RAYMATH_STATIC_INLINE
 #include "raymath.h"
 #include "2048.h"
+#include "ai.h"
+#include "profiler.h"
+#include "simulation.h"
+#include "spectator.h"
+#include "trace.h"
 
 #define STB_SPRINTF_IMPLEMENTATION
 #include "stb_sprintf.h"
@@ -12,22 +20,42 @@
     #include <stdio.h>
     #include <time.h>
     #include <string.h>
+    #include "rlgl.h"
 #endif
 
 #define CELL_SIZE 100
 #define CELL_GAP 10
 #define FIELD_MARGIN 20
-#define FIELD_WIDTH ((COLUMNS * CELL_SIZE) + ((COLUMNS - 1) * CELL_GAP) + FIELD_MARGIN*2)
-#define FIELD_HEIGHT ((ROWS * CELL_SIZE) + ((ROWS - 1) * CELL_GAP) + FIELD_MARGIN*2)
+#define FIELD_WIDTH(columns) (((columns) * CELL_SIZE) + (((columns) - 1) * CELL_GAP) + FIELD_MARGIN*2)
+#define FIELD_HEIGHT(rows) (((rows) * CELL_SIZE) + (((rows) - 1) * CELL_GAP) + FIELD_MARGIN*2)
 #define FIELD_GAP 25
 #define SCORE_HEIGHT 70
 #define SCORE_PAD 50
-#define GAME_HEIGHT (SCORE_HEIGHT + FIELD_GAP + FIELD_HEIGHT)
+#define GAME_HEIGHT(rows) (SCORE_HEIGHT + FIELD_GAP + FIELD_HEIGHT(rows))
 #define BUTTON_SIZE 60
 #define BUTTON_GAP 25
 #define ARROW_THICK 5
 #define ARROW_PAD 10
 #define SHADOW_OFFSET 7
+#define TARGET_FPS 60
+#define CELL_VALUE_PAD 8
+#define ATLAS_TILES 20 // tiles from 2 to 2^20 are pre-rendered, bigger ones are drawn directly
+#define ATLAS_COLUMNS 5
+#define ATLAS_ROWS ((ATLAS_TILES + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS)
+#define HINT_TEXT_SIZE 20
+#define HINT_PAD 6
+#define GRID_TILE_SIZE 12 // default cell size of the spectator grid
+#define GRID_MIN_TILE_SIZE 4
+#define GRID_MAX_TILE_SIZE CELL_SIZE
+#define GRID_CELL_GAP 2
+#define GRID_BOARD_GAP 6
+#define GRID_STATUS_HEIGHT 30
+// Slots of the grid atlas besides the tiles 1..ATLAS_TILES by exponent
+#define GRID_SLOT_EMPTY 0
+#define GRID_SLOT_BOARD (ATLAS_TILES + 1)
+#define GRID_SLOT_GAME_OVER (ATLAS_TILES + 2)
+#define GRID_SLOTS (ATLAS_TILES + 3)
+#define GRID_SLOT_PAD 1 // keeps bilinear filtering from bleeding into the next slot
 
 
 #ifdef PLATFORM_WEB
@@ -42,48 +70,127 @@
     #define SCORE_VALUE_TEXT_SIZE 50
 #endif
 
-#define EMPTY_CELL_COLOR ColorFromHSV(0, 0.00f, 0.45f)
-#define BACKGROUND_COLOR ColorFromHSV(0, 0.00f, 0.20f)
-#define BOARD_COLOR      ColorFromHSV(0, 0.00f, 0.30f)
-#define TEXT_COLOR       ColorFromHSV(0, 0.00f, 0.90f)
-#define ARROW_COLOR      ColorFromHSV(0, 0.00f, 0.90f)
+// Tile hues go around every 36 exponents, so the table covers every tile
+#define PALETTE_TILES 36
+#define SHADOW_BRIGHTNESS -0.5f
+
+#define EMPTY_CELL_COLOR   (palette.empty_cell)
+#define BACKGROUND_COLOR   (palette.background)
+#define BOARD_COLOR        (palette.board)
+#define BOARD_SHADOW_COLOR (palette.board_shadow)
+#define TEXT_COLOR         (palette.text)
+#define ARROW_COLOR        (palette.arrow)
+#define GAME_OVER_COLOR    (palette.game_over)
 
 void raylib_js_set_entry(void (*entry)(void));
 
+// Every color the game draws with, built once by build_palette() instead of
+// calling ColorFromHSV(), ColorBrightness() and Fade() per use. In the web
+// build each of those is a call into JavaScript.
+typedef struct {
+    Color tiles[PALETTE_TILES]; // by exponent modulo PALETTE_TILES
+    Color empty_cell;
+    Color background;
+    Color board;
+    Color board_shadow;
+    Color text;
+    Color arrow;
+    Color game_over;
+} Palette;
+
+static Palette palette = {0};
+
+// Drawing only looks at the latest snapshot of the simulation, never at the
+// engine, which may be in the middle of a move on the simulation thread
+static const Snapshot *view = NULL;
+
 
 const char *font_path = "./assets/fonts/Roboto-Bold.ttf";
 Font default_font;
 Font score_label_font;
 
 
-typedef enum {
-    GAME_PLAY,
-    GAME_MOVE_CELLS_LEFT,
-    GAME_MOVE_CELLS_RIGHT,
-    GAME_MOVE_CELLS_DOWN,
-    GAME_MOVE_CELLS_UP,
-} State;
-
-
-static State game_state = GAME_PLAY;
-static float game_time = 0.0f;
-static float max_time = 0.1f;
+// Where everything of the game screen goes, recomputed only when the window,
+// its pixel density or the board size changes. In the web build every
+// GetScreenWidth() is a call into JavaScript.
+typedef struct {
+    int screen_width;
+    int screen_height;
+    int board_size;
+    float scale;
+    Rectangle board;
+    Vector2 cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE]; // top left corners
+    Vector2 score_panel;                           // top left corner
+    Rectangle restart_button;
+    Rectangle cancel_move_button;
+} Layout;
+
+static Layout layout = {0};
+
+static RenderTexture2D tile_atlas = {0};
+static float tile_atlas_scale = 0.0f;
+
+static RenderTexture2D grid_atlas = {0};
+static float grid_atlas_scale = 0.0f;
+static int grid_atlas_tile_size = 0;
+
+typedef struct {
+    int width;
+    int height;
+    int board_size;
+    int score_digits;
+    float scale;
+} Background_Key;
+
+static RenderTexture2D background = {0};
+static Background_Key background_key = {0};
 
 float in_out_cubic(float x)
 {
     return x < 0.5 ? 4 * x * x * x : 1 - pow(-2 * x + 2, 3) / 2;
 }
 
-typedef enum {
-    MOVE_LEFT,
-    MOVE_DOWN,
-    MOVE_RIGHT,
-    MOVE_UP,
-} Move;
+// Extrapolated from the time of the snapshot, the simulation may be a few
+// milliseconds behind the frame
+float animation_progress(void)
+{
+    float t = (view->game_time + (GetTime() - view->time))/view->move_time;
+    if (t < 0.0f) t = 0.0f;
+    return in_out_cubic(t < 1.0f ? t : 1.0f);
+}
+
+// While nothing can change on the screen the frame loop blocks on input
+// events instead of redrawing the same frame TARGET_FPS times a second
+static bool idle = false;
+static double last_frame_time = 0.0;
+static long long idle_skipped_frames = 0;
 
-static Move move_buffer[100] = {0};
-static int move_buffer_size = 0;
-static int move_buffer_start = 0;
+static int window_board_size = 0;
+
+static bool show_hints = false;
+
+// Events per second, measured over at least half a second
+typedef struct {
+    double time;
+    unsigned long long count;
+    double per_second;
+} Rate_Sample;
+
+static const int autoplay_rates[] = {1, 2, 5, 10, 30, 100, 1000, AUTOPLAY_UNLIMITED};
+#define AUTOPLAY_RATE_COUNT ((int)(sizeof(autoplay_rates)/sizeof(autoplay_rates[0])))
+static bool autoplay = false;
+static int autoplay_rate_index = 3;
+static Rate_Sample autoplay_speed = {0};
+
+// The spectator grid replaces the game on the screen while it is shown
+static const int grid_counts[] = {16, 36, 64, 100, 144, 196, 256};
+#define GRID_COUNT_OPTIONS ((int)(sizeof(grid_counts)/sizeof(grid_counts[0])))
+static bool grid = false;
+static int grid_count_index = 0;
+static int grid_board_size = DEFAULT_BOARD_SIZE;
+static int grid_tile_size = GRID_TILE_SIZE;
+static const Spectator_Snapshot *grid_view = NULL;
+static Rate_Sample grid_speed = {0};
 
 
 void _draw_arrow(int x, int y, float angle, float angle2, Color arrow_color)
@@ -105,213 +212,673 @@ void _draw_arrow(int x, int y, float angle, float angle2, Color arrow_color)
 }
 
 
-void draw_shadow_rec(Rectangle src, Color color)
+void build_palette(void)
 {
-    DrawRectangle(src.x + SHADOW_OFFSET, src.y + SHADOW_OFFSET, src.width, src.height, ColorBrightness(color, -.5f));
+    for (int exponent = 0; exponent < PALETTE_TILES; ++exponent) {
+        palette.tiles[exponent] = ColorFromHSV(exponent*10, 0.45f, 0.85f);
+    }
+    palette.empty_cell   = ColorFromHSV(0, 0.00f, 0.45f);
+    palette.background   = ColorFromHSV(0, 0.00f, 0.20f);
+    palette.board        = ColorFromHSV(0, 0.00f, 0.30f);
+    palette.board_shadow = ColorBrightness(palette.board, SHADOW_BRIGHTNESS);
+    palette.text         = ColorFromHSV(0, 0.00f, 0.90f);
+    palette.arrow        = ColorFromHSV(0, 0.00f, 0.90f);
+    palette.game_over    = Fade(palette.background, 0.7f);
 }
 
 
-void draw_shadow(int x, int y, int width, int height, Color color)
+void draw_shadow_rec(Rectangle src, Color shadow_color)
+{
+    DrawRectangle(src.x + SHADOW_OFFSET, src.y + SHADOW_OFFSET, src.width, src.height, shadow_color);
+}
+
+
+void draw_shadow(int x, int y, int width, int height, Color shadow_color)
 {
     Rectangle src = {
         x, y, width, height
     };
-    draw_shadow_rec(src, color);
+    draw_shadow_rec(src, shadow_color);
 }
 
 
-void draw_cell_value(int cell_value, int x, int y)
+void draw_cell_value(int cell_value, int x, int y, float size)
 {
     static char text_buffer[4096] = {0};
     stbsp_snprintf(text_buffer, sizeof(text_buffer), "%d", cell_value);
-    Vector2 text_size = MeasureTextEx(default_font, text_buffer, CELL_VALUE_DEFAULT_FONT_SIZE, 1);
+    float font_size = CELL_VALUE_DEFAULT_FONT_SIZE*size/CELL_SIZE;
+    float max_width = (CELL_SIZE - CELL_VALUE_PAD*2)*size/CELL_SIZE;
+    Vector2 text_size = MeasureTextEx(default_font, text_buffer, font_size, 1);
+    // Tiles from 65536 up do not fit into the cell with the default font size
+    if (text_size.x > max_width) {
+        font_size *= max_width / text_size.x;
+        text_size = MeasureTextEx(default_font, text_buffer, font_size, 1);
+    }
     Vector2 pos = {
-        .x = x + CELL_SIZE/2 - text_size.x/2,
-        .y = y + CELL_SIZE/2 - text_size.y/2,
+        .x = x + size/2 - text_size.x/2,
+        .y = y + size/2 - text_size.y/2,
     };
-    DrawTextEx(default_font, text_buffer, pos, CELL_VALUE_DEFAULT_FONT_SIZE, 1, TEXT_COLOR);
+    DrawTextEx(default_font, text_buffer, pos, font_size, 1, TEXT_COLOR);
 }
 
 
 Color get_cell_color(int cell_value)
 {
-    int hue = (int)(0 + log2(cell_value) * 10) % 360;
-    Color color = ColorFromHSV(hue, 0.45f, 0.85f);
-    return color;
+    int exponent = 0;
+    for (int value = cell_value; value > 1; value >>= 1) ++exponent;
+    return palette.tiles[exponent % PALETTE_TILES];
+}
+
+
+void render_tile(int cell_value, int x, int y, float size)
+{
+    Rectangle cell_rect = {x, y, size, size};
+    DrawRectangleRounded(cell_rect, ROUNDNESS, 0, get_cell_color(cell_value));
+    draw_cell_value(cell_value, x, y, size);
+}
+
+
+// Render every tile up to ATLAS_TILES once at the pixel density of the
+// window. Has to be called outside of BeginDrawing()/EndDrawing().
+void update_tile_atlas(void)
+{
+    float scale = layout.scale;
+    if (scale == tile_atlas_scale) return;
+    if (tile_atlas_scale != 0.0f) UnloadRenderTexture(tile_atlas);
+    tile_atlas_scale = scale;
+
+    int size = CELL_SIZE*scale;
+    tile_atlas = LoadRenderTexture(size*ATLAS_COLUMNS, size*ATLAS_ROWS);
+    SetTextureFilter(tile_atlas.texture, TEXTURE_FILTER_BILINEAR);
+    BeginTextureMode(tile_atlas);
+        ClearBackground(BLANK);
+        for (int i = 0; i < ATLAS_TILES; ++i) {
+            render_tile(1 << (i + 1), (i % ATLAS_COLUMNS)*size, (i / ATLAS_COLUMNS)*size, size);
+        }
+    EndTextureMode();
+}
+
+
+void draw_tile(int cell_value, int x, int y)
+{
+    int exponent = 0;
+    for (int value = cell_value; value > 1; value >>= 1) ++exponent;
+    if (exponent < 1 || exponent > ATLAS_TILES) {
+        render_tile(cell_value, x, y, CELL_SIZE);
+        return;
+    }
+
+    // Render textures are stored upside down, hence the flipped source rectangle
+    float size = CELL_SIZE*tile_atlas_scale;
+    int i = exponent - 1;
+    Rectangle source = {
+        (i % ATLAS_COLUMNS)*size, (ATLAS_ROWS - 1 - i / ATLAS_COLUMNS)*size, size, -size
+    };
+    Rectangle dest = {x, y, CELL_SIZE, CELL_SIZE};
+    DrawTexturePro(tile_atlas.texture, source, dest, (Vector2){0, 0}, 0.0f, WHITE);
+}
+
+
+void update_layout(void)
+{
+    bool dirty = layout.screen_width == 0 || layout.board_size != view->board_size || IsWindowResized();
+#ifndef PLATFORM_WEB
+    // Natively a plain read, raylib.js always reports 1
+    if (GetWindowScaleDPI().x != layout.scale) dirty = true;
+#endif
+    if (!dirty) return;
+
+    layout.screen_width = GetScreenWidth();
+    layout.screen_height = GetScreenHeight();
+    int size = view->board_size;
+    layout.board_size = size;
+    layout.scale = GetWindowScaleDPI().x;
+
+    int sx = layout.screen_width/2 - FIELD_WIDTH(size)/2;
+    int sy = layout.screen_height/2 - GAME_HEIGHT(size)/2;
+    layout.score_panel = (Vector2){sx, sy};
+    layout.board = (Rectangle){sx, sy + SCORE_HEIGHT + FIELD_GAP, FIELD_WIDTH(size), FIELD_HEIGHT(size)};
+    for (int cy = 0; cy < size; cy++) {
+        for (int cx = 0; cx < size; cx++) {
+            layout.cells[cy][cx] = (Vector2){
+                layout.board.x + FIELD_MARGIN + cx*(CELL_SIZE + CELL_GAP),
+                layout.board.y + FIELD_MARGIN + cy*(CELL_SIZE + CELL_GAP),
+            };
+        }
+    }
+
+    int button_y = sy + SCORE_HEIGHT/2 - BUTTON_SIZE/2;
+    layout.restart_button = (Rectangle){sx + FIELD_WIDTH(size) - BUTTON_SIZE, button_y, BUTTON_SIZE, BUTTON_SIZE};
+    layout.cancel_move_button = (Rectangle){
+        sx + FIELD_WIDTH(size) - BUTTON_SIZE*2 - BUTTON_GAP, button_y, BUTTON_SIZE, BUTTON_SIZE
+    };
 }
 
 
 void draw_move_cells(void)
 {
-    int sx = GetScreenWidth()/2 - FIELD_WIDTH/2 + FIELD_MARGIN;
-    int sy = GetScreenHeight()/2 - GAME_HEIGHT/2 + SCORE_HEIGHT + FIELD_GAP + FIELD_MARGIN;
+    float progress = animation_progress();
 
-    for (int cy = 0; cy < ROWS; cy++) {
-        for (int cx = 0; cx < COLUMNS; cx++) {
-            int offset = movement_at(cx, cy);
-            int cell_value = cell_at(cx, cy);
+    int size = view->board_size;
+    for (int cy = 0; cy < size; cy++) {
+        for (int cx = 0; cx < size; cx++) {
+            int offset = view->movement[cy][cx];
+            int cell_value = view->cells[cy][cx];
             if (offset == 0) {
                 continue;
             }
-            int start_x = sx + (cx * CELL_SIZE) + (cx * CELL_GAP);
-            int start_y = sy + (cy * CELL_SIZE) + (cy * CELL_GAP);
-            int x = start_x;
-            int y = start_y;
-
-            if (game_state == GAME_MOVE_CELLS_RIGHT) {
-                int end_x = sx + ((cx + offset) * CELL_SIZE) + ((cx+offset) * CELL_GAP);
-                x = Lerp(start_x, end_x, in_out_cubic(game_time/max_time));
-            } else if (game_state == GAME_MOVE_CELLS_LEFT) {
-                int end_x = sx + ((cx-offset) * CELL_SIZE) + ((cx-offset) * CELL_GAP);
-                x = Lerp(start_x, end_x, in_out_cubic(game_time/max_time));
-            } else if (game_state == GAME_MOVE_CELLS_UP) {
-                int end_y = sy + ((cy-offset) * CELL_SIZE) + ((cy-offset) * CELL_GAP);
-                y = Lerp(start_y, end_y, in_out_cubic(game_time/max_time));
-            } else if (game_state == GAME_MOVE_CELLS_DOWN) {
-                int end_y = sy + ((cy+offset) * CELL_SIZE) + ((cy+offset) * CELL_GAP);
-                y = Lerp(start_y, end_y, in_out_cubic(game_time/max_time));
+            Vector2 start = layout.cells[cy][cx];
+            int x = start.x;
+            int y = start.y;
+
+            if (view->state == GAME_MOVE_CELLS_RIGHT) {
+                x = Lerp(start.x, layout.cells[cy][cx + offset].x, progress);
+            } else if (view->state == GAME_MOVE_CELLS_LEFT) {
+                x = Lerp(start.x, layout.cells[cy][cx - offset].x, progress);
+            } else if (view->state == GAME_MOVE_CELLS_UP) {
+                y = Lerp(start.y, layout.cells[cy - offset][cx].y, progress);
+            } else if (view->state == GAME_MOVE_CELLS_DOWN) {
+                y = Lerp(start.y, layout.cells[cy + offset][cx].y, progress);
             }
 
-            Rectangle cell_rect = {x, y, CELL_SIZE, CELL_SIZE};
-            DrawRectangleRounded(cell_rect, ROUNDNESS, 0, get_cell_color(cell_value));
-            if (cell_value != 0) {
-                draw_cell_value(cell_value, x, y);
-            }
+            draw_tile(cell_value, x, y);
         }
     }
 }
 
 void draw_board(void)
 {
-    int sx = GetScreenWidth()/2 - FIELD_WIDTH/2 + FIELD_MARGIN;
-    int sy = GetScreenHeight()/2 - GAME_HEIGHT/2 + SCORE_HEIGHT + FIELD_GAP + FIELD_MARGIN;
-
-    Rectangle board_rec = {sx - FIELD_MARGIN, sy - FIELD_MARGIN,  FIELD_WIDTH, FIELD_HEIGHT};
-    draw_shadow_rec(board_rec, BOARD_COLOR);
-    DrawRectangleRec(board_rec, BOARD_COLOR);
-
-    for (int cy = 0; cy < ROWS; cy++) {
-        for (int cx = 0; cx < COLUMNS; cx++) {
-            int cell_value = cell_at(cx, cy);
-            int x = sx + (cx * CELL_SIZE) + (cx * CELL_GAP);
-            int y = sy + (cy * CELL_SIZE) + (cy * CELL_GAP);
-            Rectangle cell_rect = {x, y, CELL_SIZE, CELL_SIZE};
-            if (cell_value != 0) {
-                if (game_state != GAME_PLAY) {
-                    int x_offset = movement_at(cx, cy);
-                    if (x_offset > 0) {
-                        DrawRectangleRounded(cell_rect, ROUNDNESS, 0, EMPTY_CELL_COLOR);
-                        continue;
-                    };
-                }
+    TRACE_SCOPE("draw_board");
+    // The board and the empty cells are a part of the background
+    int size = view->board_size;
+    for (int cy = 0; cy < size; cy++) {
+        for (int cx = 0; cx < size; cx++) {
+            int cell_value = view->cells[cy][cx];
+            if (cell_value == 0) continue;
+            if (view->state != GAME_PLAY && view->movement[cy][cx] > 0) continue;
+            draw_tile(cell_value, layout.cells[cy][cx].x, layout.cells[cy][cx].y);
+        }
+    }
+    if (view->state != GAME_PLAY) draw_move_cells();
+
+    if (view->game_over) {
+        Rectangle board_rec = layout.board;
+        DrawRectangleRec(board_rec, GAME_OVER_COLOR);
+        Vector2 text_size = MeasureTextEx(default_font, "Game over", CELL_VALUE_DEFAULT_FONT_SIZE, 1);
+        Vector2 pos = {
+            .x = board_rec.x + board_rec.width/2 - text_size.x/2,
+            .y = board_rec.y + board_rec.height/2 - text_size.y/2,
+        };
+        DrawTextEx(default_font, "Game over", pos, CELL_VALUE_DEFAULT_FONT_SIZE, 1, TEXT_COLOR);
+    }
+}
+
+
+bool hints_wanted(void)
+{
+    return show_hints && view->state == GAME_PLAY && !view->game_over;
+}
+
+
+// Starts searching the board on the screen, a no-op while it stays the same
+void update_hints(void)
+{
+    if (!hints_wanted()) return;
+    ai_search(view->cells, view->board_size);
+    ai_update();
+}
+
+
+// The hint of a direction sits in the middle of the board edge it points to
+Vector2 hint_position(Rectangle board_rec, Direction direction)
+{
+    switch (direction) {
+        case DIRECTION_LEFT:  return (Vector2){board_rec.x, board_rec.y + board_rec.height/2};
+        case DIRECTION_DOWN:  return (Vector2){board_rec.x + board_rec.width/2, board_rec.y + board_rec.height};
+        case DIRECTION_RIGHT: return (Vector2){board_rec.x + board_rec.width, board_rec.y + board_rec.height/2};
+        case DIRECTION_UP:    return (Vector2){board_rec.x + board_rec.width/2, board_rec.y};
+        default:              return (Vector2){0, 0};
+    }
+}
+
 
-                DrawRectangleRounded(cell_rect, ROUNDNESS, 0, get_cell_color(cell_value));
-                draw_cell_value(cell_value, x, y);
+void draw_hints(void)
+{
+    if (!hints_wanted()) return;
+    TRACE_SCOPE("draw_hints");
+    static const char *direction_names[DIRECTION_COUNT] = {
+        [DIRECTION_LEFT]  = "Left",
+        [DIRECTION_DOWN]  = "Down",
+        [DIRECTION_RIGHT] = "Right",
+        [DIRECTION_UP]    = "Up",
+    };
+    static char text_buffer[64] = {0};
+
+    Ai_Result result;
+    ai_result(&result);
+    if (result.depth == 0) return;
+
+    Rectangle board_rec = layout.board;
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+        if (result.can_move[d]) {
+            stbsp_snprintf(text_buffer, sizeof(text_buffer), "%s %.0f", direction_names[d], result.value[d]);
+        } else {
+            stbsp_snprintf(text_buffer, sizeof(text_buffer), "%s -", direction_names[d]);
+        }
+        Vector2 text_size = MeasureTextEx(default_font, text_buffer, HINT_TEXT_SIZE, 1);
+        Vector2 center = hint_position(board_rec, d);
+        Rectangle box = {
+            center.x - text_size.x/2 - HINT_PAD, center.y - text_size.y/2 - HINT_PAD,
+            text_size.x + HINT_PAD*2, text_size.y + HINT_PAD*2,
+        };
+        bool best = d == result.best;
+        DrawRectangleRec(box, best ? ARROW_COLOR : BOARD_COLOR);
+        Vector2 pos = {box.x + HINT_PAD, box.y + HINT_PAD};
+        DrawTextEx(default_font, text_buffer, pos, HINT_TEXT_SIZE, 1, best ? BOARD_COLOR : TEXT_COLOR);
+    }
+
+    stbsp_snprintf(text_buffer, sizeof(text_buffer), "depth %d%s", result.depth, result.done ? "" : "...");
+    Vector2 pos = {board_rec.x, board_rec.y + board_rec.height + HINT_PAD};
+    DrawTextEx(default_font, text_buffer, pos, HINT_TEXT_SIZE, 1, TEXT_COLOR);
+}
+
+
+void sample_rate(Rate_Sample *sample, unsigned long long count)
+{
+    double now = GetTime();
+    if (now - sample->time < 0.5) return;
+    if (count >= sample->count && sample->time > 0.0) {
+        sample->per_second = (count - sample->count)/(now - sample->time);
+    }
+    sample->time = now;
+    sample->count = count;
+}
+
+
+void draw_autoplay(void)
+{
+    if (view->autoplay_rate == AUTOPLAY_OFF) return;
+    static char rate_buffer[32] = {0};
+    static char text_buffer[128] = {0};
 
+    sample_rate(&autoplay_speed, view->autoplay_moves);
+
+    if (view->autoplay_rate == AUTOPLAY_UNLIMITED) {
+        stbsp_snprintf(rate_buffer, sizeof(rate_buffer), "max");
+    } else {
+        stbsp_snprintf(rate_buffer, sizeof(rate_buffer), "%d/s", view->autoplay_rate);
+    }
+    stbsp_snprintf(text_buffer, sizeof(text_buffer), "autoplay %s: %.0f moves/s, depth %d",
+                   rate_buffer, autoplay_speed.per_second, view->autoplay_depth);
+    Rectangle board_rec = layout.board;
+    Vector2 text_size = MeasureTextEx(default_font, text_buffer, HINT_TEXT_SIZE, 1);
+    Vector2 pos = {board_rec.x + board_rec.width - text_size.x, board_rec.y + board_rec.height + HINT_PAD};
+    DrawTextEx(default_font, text_buffer, pos, HINT_TEXT_SIZE, 1, TEXT_COLOR);
+}
+
+
+void send_autoplay(double time)
+{
+    int rate = autoplay ? autoplay_rates[autoplay_rate_index] : AUTOPLAY_OFF;
+    simulation_send((Command){COMMAND_SET_AUTOPLAY, rate, time});
+}
+
+
+void resize_window(void)
+{
+    int size = view->board_size;
+    SetWindowSize(FIELD_WIDTH(size) + FIELD_GAP*2, FIELD_HEIGHT(size) + FIELD_GAP*2 + SCORE_HEIGHT);
+    window_board_size = size;
+    layout.screen_width = 0;
+}
+
+
+// Renders the empty cell, every tile up to ATLAS_TILES and two solid colors
+// at the cell size of the grid, so the whole grid is drawn from one texture.
+// Has to be called outside of BeginDrawing()/EndDrawing().
+void update_grid_atlas(void)
+{
+    float scale = layout.scale;
+    if (scale == grid_atlas_scale && grid_tile_size == grid_atlas_tile_size) return;
+    if (grid_atlas_scale != 0.0f) UnloadRenderTexture(grid_atlas);
+    grid_atlas_scale = scale;
+    grid_atlas_tile_size = grid_tile_size;
+
+    int size = grid_tile_size*scale;
+    int slot = size + GRID_SLOT_PAD*2;
+    grid_atlas = LoadRenderTexture(slot*GRID_SLOTS, slot);
+    SetTextureFilter(grid_atlas.texture, TEXTURE_FILTER_BILINEAR);
+    BeginTextureMode(grid_atlas);
+        ClearBackground(BLANK);
+        for (int i = 0; i < GRID_SLOTS; ++i) {
+            int x = i*slot + GRID_SLOT_PAD;
+            int y = GRID_SLOT_PAD;
+            if (i == GRID_SLOT_EMPTY) {
+                DrawRectangleRounded((Rectangle){x, y, size, size}, ROUNDNESS, 0, EMPTY_CELL_COLOR);
+            } else if (i == GRID_SLOT_BOARD) {
+                DrawRectangle(i*slot, 0, slot, slot, BOARD_COLOR);
+            } else if (i == GRID_SLOT_GAME_OVER) {
+                DrawRectangle(i*slot, 0, slot, slot, GAME_OVER_COLOR);
             } else {
-                DrawRectangleRounded(cell_rect, ROUNDNESS, 0, EMPTY_CELL_COLOR);
+                render_tile(1 << i, x, y, size);
             }
         }
+    EndTextureMode();
+}
+
+
+// Solid slots are stretched from their center texel
+Rectangle grid_slot_source(int slot_index)
+{
+    float size = grid_atlas_tile_size*grid_atlas_scale;
+    float slot = (int)size + GRID_SLOT_PAD*2;
+    if (slot_index == GRID_SLOT_BOARD || slot_index == GRID_SLOT_GAME_OVER) {
+        return (Rectangle){slot_index*slot + slot/2, slot/2, 1, 1};
     }
-    if (game_state != GAME_PLAY) draw_move_cells();
+    return (Rectangle){slot_index*slot + GRID_SLOT_PAD, GRID_SLOT_PAD, (int)size, (int)size};
 }
 
 
-void draw_score(void)
+// Natively the quads go straight into the rlgl batch. They all share the
+// atlas texture, so the grid costs one draw call per filled batch instead of
+// one per rounded rectangle and text. Canvas 2D has no batching, there every
+// quad is a drawImage() of the atlas.
+void grid_begin(void)
 {
-    static char text_buffer[4096] = {0};
-    int sx = GetScreenWidth()/2 - FIELD_WIDTH/2;
-    int sy = GetScreenHeight()/2 - GAME_HEIGHT/2;
+#ifndef PLATFORM_WEB
+    rlSetTexture(grid_atlas.texture.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(255, 255, 255, 255);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+#endif
+}
 
 
-    int score = get_score();
-    stbsp_snprintf(text_buffer, sizeof(text_buffer), "%d", score);
+// `source` is in pixels of the atlas counted from the top
+void grid_quad(Rectangle source, Rectangle dest)
+{
+    float height = grid_atlas.texture.height;
+#ifdef PLATFORM_WEB
+    // Render textures are stored upside down, hence the flipped source rectangle
+    Rectangle flipped = {source.x, height - source.y - source.height, source.width, -source.height};
+    DrawTexturePro(grid_atlas.texture, flipped, dest, (Vector2){0, 0}, 0.0f, WHITE);
+#else
+    float width = grid_atlas.texture.width;
+    float left = source.x/width;
+    float right = (source.x + source.width)/width;
+    // Render textures are stored upside down
+    float top = 1.0f - source.y/height;
+    float bottom = 1.0f - (source.y + source.height)/height;
+    rlTexCoord2f(left, top);
+    rlVertex2f(dest.x, dest.y);
+    rlTexCoord2f(left, bottom);
+    rlVertex2f(dest.x, dest.y + dest.height);
+    rlTexCoord2f(right, bottom);
+    rlVertex2f(dest.x + dest.width, dest.y + dest.height);
+    rlTexCoord2f(right, top);
+    rlVertex2f(dest.x + dest.width, dest.y);
+#endif
+}
 
-    Vector2 text_size = MeasureTextEx(score_label_font, "Score", SCORE_LABEL_TEXT_SIZE, 1);
-    Vector2 value_text_size = MeasureTextEx(default_font, text_buffer, SCORE_VALUE_TEXT_SIZE, 1);
-    int score_width = value_text_size.x + SCORE_PAD*2;
 
-    Vector2 value_pos = {sx + score_width/2 - value_text_size.x/2, sy + 20};
-    Vector2 pos = {.x = sx + score_width/2 - text_size.x/2, .y = sy};
+void grid_end(void)
+{
+#ifndef PLATFORM_WEB
+    rlEnd();
+    rlSetTexture(0);
+#endif
+}
 
 
-    draw_shadow(sx, sy, score_width, SCORE_HEIGHT, BOARD_COLOR);
-    DrawRectangle(sx, sy, score_width, SCORE_HEIGHT, BOARD_COLOR);
-    DrawTextEx(score_label_font, "Score", pos, SCORE_LABEL_TEXT_SIZE, 1, TEXT_COLOR);
-    DrawTextEx(default_font, text_buffer, value_pos, SCORE_VALUE_TEXT_SIZE, 1, TEXT_COLOR);
+int grid_columns(int count)
+{
+    int columns = 1;
+    while (columns*columns < count) ++columns;
+    return columns;
+}
+
+
+int grid_board_width(int board_size)
+{
+    return board_size*grid_tile_size + (board_size + 1)*GRID_CELL_GAP;
+}
+
+
+Rectangle grid_board_rect(int index, int board_size, int columns)
+{
+    int width = grid_board_width(board_size);
+    int x = GRID_BOARD_GAP + (index % columns)*(width + GRID_BOARD_GAP);
+    int y = GRID_STATUS_HEIGHT + (index / columns)*(width + GRID_BOARD_GAP);
+    return (Rectangle){x, y, width, width};
+}
+
+
+void draw_grid(void)
+{
+    TRACE_SCOPE("draw_grid");
+    static char text_buffer[128] = {0};
+    int count = grid_view->count;
+    int size = grid_view->board_size;
+    int columns = grid_columns(count);
+
+    // The boards, their cells and the game over shades each go in one pass
+    grid_begin();
+    Rectangle board_source = grid_slot_source(GRID_SLOT_BOARD);
+    for (int i = 0; i < count; ++i) {
+        grid_quad(board_source, grid_board_rect(i, size, columns));
+    }
+    for (int i = 0; i < count; ++i) {
+        Rectangle board_rec = grid_board_rect(i, size, columns);
+        const unsigned char *cells = grid_view->games[i].cells;
+        for (int c = 0; c < size*size; ++c) {
+            // Tiles past 2^20 share its slot. Players that look one move
+            // ahead hardly get there, even on 8x8.
+            int exponent = cells[c] < ATLAS_TILES ? cells[c] : ATLAS_TILES;
+            Rectangle dest = {
+                board_rec.x + GRID_CELL_GAP + (c % size)*(grid_tile_size + GRID_CELL_GAP),
+                board_rec.y + GRID_CELL_GAP + (c / size)*(grid_tile_size + GRID_CELL_GAP),
+                grid_tile_size, grid_tile_size,
+            };
+            grid_quad(grid_slot_source(exponent), dest);
+        }
+    }
+    Rectangle game_over_source = grid_slot_source(GRID_SLOT_GAME_OVER);
+    for (int i = 0; i < count; ++i) {
+        if (grid_view->games[i].over) grid_quad(game_over_source, grid_board_rect(i, size, columns));
+    }
+    grid_end();
+
+    sample_rate(&grid_speed, grid_view->moves);
+    char best[32] = "-"; // no tile yet
+    if (grid_view->best_exponent > 0) stbsp_snprintf(best, sizeof(best), "%lld", 1LL << grid_view->best_exponent);
+    stbsp_snprintf(text_buffer, sizeof(text_buffer), "%d games of %dx%d: %.0f moves/s, %llu finished, best %s",
+                   count, size, size, grid_speed.per_second, grid_view->games_finished, best);
+    Vector2 pos = {GRID_BOARD_GAP, GRID_STATUS_HEIGHT/2 - HINT_TEXT_SIZE/2};
+    DrawTextEx(default_font, text_buffer, pos, HINT_TEXT_SIZE, 1, TEXT_COLOR);
 }
 
 
-void queue_move(Move move)
+void resize_grid_window(void)
 {
-    move_buffer[(move_buffer_start + move_buffer_size) % 100] = move;
-    if (move_buffer_size < 100)
-        move_buffer_size++;
-    else
-        move_buffer_start = (move_buffer_start + 1) % 100;
+    int count = grid_counts[grid_count_index];
+    int columns = grid_columns(count);
+    int rows = (count + columns - 1)/columns;
+    int width = grid_board_width(grid_board_size) + GRID_BOARD_GAP;
+    SetWindowSize(columns*width + GRID_BOARD_GAP, GRID_STATUS_HEIGHT + rows*width);
 }
 
-bool dequeue_move(Move *move)
+
+void start_grid(void)
 {
-    if (move_buffer_size == 0) return false;
+    spectator_start(grid_counts[grid_count_index], grid_board_size);
+    grid_view = spectator_snapshot();
+    grid_speed = (Rate_Sample){0};
+    resize_grid_window();
+}
 
-    *move = move_buffer[move_buffer_start];
-    move_buffer_size--;
-    move_buffer_start = (move_buffer_start + 1) % 100;
-    return true;
+
+void set_grid(bool on)
+{
+    grid = on;
+    if (grid) {
+        start_grid();
+    } else {
+        spectator_stop();
+        resize_window();
+    }
 }
 
-void restart_game(void)
+
+void capture_grid_input(void)
 {
-    clear_board();
-    add_random_cell();
-    save_prev_board();
-    save_back_board();
-    Move move;
-    while (dequeue_move(&move) == true);
-    reset_score();
-    game_state = GAME_PLAY;
+    if (IsKeyPressed(KEY_LEFT_BRACKET) && grid_count_index > 0) {
+        grid_count_index--;
+        start_grid();
+    }
+
+    if (IsKeyPressed(KEY_RIGHT_BRACKET) && grid_count_index < GRID_COUNT_OPTIONS - 1) {
+        grid_count_index++;
+        start_grid();
+    }
+
+    for (int size = MIN_BOARD_SIZE; size <= MAX_BOARD_SIZE; ++size) {
+        if (IsKeyPressed(KEY_ZERO + size) && size != grid_board_size) {
+            grid_board_size = size;
+            start_grid();
+        }
+    }
 }
 
 
+int count_digits(long long value)
+{
+    int digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        ++digits;
+    }
+    return digits;
+}
+
+
+// The panel width only depends on the number of digits, so it does not
+// wobble and the background only has to be redrawn once per digit
+int score_panel_width(int digits)
+{
+    static char text_buffer[32] = {0};
+    if (digits > (int)sizeof(text_buffer) - 1) digits = sizeof(text_buffer) - 1;
+    for (int i = 0; i < digits; ++i) text_buffer[i] = '0';
+    text_buffer[digits] = '\0';
+    Vector2 text_size = MeasureTextEx(default_font, text_buffer, SCORE_VALUE_TEXT_SIZE, 1);
+    return text_size.x + SCORE_PAD*2;
+}
+
+
+void draw_score(void)
+{
+    TRACE_SCOPE("draw_score");
+    static char text_buffer[4096] = {0};
+    int sx = layout.score_panel.x;
+    int sy = layout.score_panel.y;
+
+    long long score = view->score;
+    stbsp_snprintf(text_buffer, sizeof(text_buffer), "%lld", score);
+
+    // The panel and the label are a part of the background
+    Vector2 value_text_size = MeasureTextEx(default_font, text_buffer, SCORE_VALUE_TEXT_SIZE, 1);
+    int score_width = score_panel_width(count_digits(score));
+
+    Vector2 value_pos = {sx + score_width/2 - value_text_size.x/2, sy + 20};
+    DrawTextEx(default_font, text_buffer, value_pos, SCORE_VALUE_TEXT_SIZE, 1, TEXT_COLOR);
+}
+
+
+// Polled at the start of the frame so the moves are applied before the frame
+// is drawn and show up in it
 void capture_input(void)
 {
+    TRACE_SCOPE("capture_input");
+    double time = GetTime();
+    Vector2 mouse = GetMousePosition();
+    bool clicked = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+
+    if (IsKeyPressed(KEY_F3)) {
+        profiler_toggle(TARGET_FPS);
+    }
+
+    if (IsKeyPressed(KEY_F4)) {
+        TRACE_FLUSH("trace.json");
+    }
+
+    if (IsKeyPressed(KEY_G)) {
+        set_grid(!grid);
+    }
+
+    if (grid) {
+        capture_grid_input();
+        return;
+    }
+
     if (IsKeyPressed(KEY_D) || IsKeyPressed(KEY_RIGHT)) {
-        queue_move(MOVE_RIGHT);
+        simulation_send((Command){COMMAND_MOVE, MOVE_RIGHT, time});
     }
 
     if (IsKeyPressed(KEY_S) || IsKeyPressed(KEY_DOWN)) {
-        queue_move(MOVE_DOWN);
+        simulation_send((Command){COMMAND_MOVE, MOVE_DOWN, time});
     }
 
     if (IsKeyPressed(KEY_A) || IsKeyPressed(KEY_LEFT)) {
-        queue_move(MOVE_LEFT);
+        simulation_send((Command){COMMAND_MOVE, MOVE_LEFT, time});
     }
 
     if (IsKeyPressed(KEY_W) || IsKeyPressed(KEY_UP)) {
-        queue_move(MOVE_UP);
+        simulation_send((Command){COMMAND_MOVE, MOVE_UP, time});
+    }
+
+    if (IsKeyPressed(KEY_R) || (clicked && CheckCollisionPointRec(mouse, layout.restart_button))) {
+        simulation_send((Command){COMMAND_RESTART, 0, time});
     }
 
-    if (IsKeyPressed(KEY_R)) {
-        restart_game();
+    if (IsKeyPressed(KEY_P) || (clicked && CheckCollisionPointRec(mouse, layout.cancel_move_button))) {
+        simulation_send((Command){COMMAND_CANCEL_MOVE, 0, time});
     }
 
-    if (IsKeyPressed(KEY_P)) {
-        cancel_move();
+    if (IsKeyPressed(KEY_H)) {
+        show_hints = !show_hints;
+    }
+
+    if (IsKeyPressed(KEY_O)) {
+        autoplay = !autoplay;
+        send_autoplay(time);
+    }
+
+    if (IsKeyPressed(KEY_MINUS) && autoplay_rate_index > 0) {
+        autoplay_rate_index--;
+        if (autoplay) send_autoplay(time);
+    }
+
+    if (IsKeyPressed(KEY_EQUAL) && autoplay_rate_index < AUTOPLAY_RATE_COUNT - 1) {
+        autoplay_rate_index++;
+        if (autoplay) send_autoplay(time);
+    }
+
+    for (int size = MIN_BOARD_SIZE; size <= MAX_BOARD_SIZE; ++size) {
+        if (IsKeyPressed(KEY_ZERO + size) && size != view->board_size) {
+            simulation_send((Command){COMMAND_SET_BOARD_SIZE, size, time});
+        }
     }
 }
 
-void draw_cancel_move_button(void)
+
+void render_cancel_move_button(bool hoverover)
 {
-    int x = GetScreenWidth()/2 + FIELD_WIDTH/2 - BUTTON_SIZE*2 - BUTTON_GAP;
-    int y = GetScreenHeight()/2 - GAME_HEIGHT/2 + SCORE_HEIGHT/2 - BUTTON_SIZE/2;
+    Rectangle button_rec = layout.cancel_move_button;
+    int x = button_rec.x;
+    int y = button_rec.y;
 
     int arrow_radius = (BUTTON_SIZE - ARROW_PAD*2) / 2;
     Vector2 button_center = {.x = x + BUTTON_SIZE/2, .y = y + BUTTON_SIZE/2};
-    Rectangle button_rec = {x, y, BUTTON_SIZE, BUTTON_SIZE};
-    bool hoverover = CheckCollisionPointRec(GetMousePosition(), button_rec);
     Color button_color = hoverover ? ARROW_COLOR : BOARD_COLOR;
-    draw_shadow_rec(button_rec, BOARD_COLOR);
     DrawRectangleRec(button_rec, button_color);
 
     Color arrow_color = hoverover ? BOARD_COLOR : ARROW_COLOR;
@@ -320,23 +887,27 @@ void draw_cancel_move_button(void)
     DrawRing(center, arrow_radius-ARROW_THICK, arrow_radius, -150, 60, 20, arrow_color);
 
     _draw_arrow(button_center.x, button_center.y, -145*PI/180, -175*PI/180, arrow_color);
+}
 
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && hoverover) {
-        cancel_move();
-    }
+void draw_cancel_move_button(void)
+{
+    TRACE_SCOPE("draw_cancel_move_button");
+    Rectangle button_rec = layout.cancel_move_button;
+    bool hoverover = CheckCollisionPointRec(GetMousePosition(), button_rec);
+    // The button without hover is a part of the background
+    if (hoverover) render_cancel_move_button(true);
 }
 
-void draw_restart_button(void)
+
+void render_restart_button(bool hoverover)
 {
-    int x = GetScreenWidth()/2 + FIELD_WIDTH/2 - BUTTON_SIZE;
-    int y = GetScreenHeight()/2 - GAME_HEIGHT/2 + SCORE_HEIGHT/2 - BUTTON_SIZE/2;
+    Rectangle button_rec = layout.restart_button;
+    int x = button_rec.x;
+    int y = button_rec.y;
 
     int arrow_radius = (BUTTON_SIZE - ARROW_PAD*2) / 2;
     Vector2 button_center = {.x = x + BUTTON_SIZE/2, .y = y + BUTTON_SIZE/2};
-    Rectangle button_rec = {x, y, BUTTON_SIZE, BUTTON_SIZE};
-    bool hoverover = CheckCollisionPointRec(GetMousePosition(), button_rec);
     Color button_color = hoverover ? ARROW_COLOR : BOARD_COLOR;
-    draw_shadow_rec(button_rec, BOARD_COLOR);
     DrawRectangleRec(button_rec, button_color);
 
     Color arrow_color = hoverover ? BOARD_COLOR : ARROW_COLOR;
@@ -347,90 +918,263 @@ void draw_restart_button(void)
 
     _draw_arrow(button_center.x, button_center.y, -150*PI/180, -175*PI/180, arrow_color);
     _draw_arrow(button_center.x, button_center.y, 30*PI/180, 0*PI/180, arrow_color);
+}
 
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && hoverover) {
-        restart_game();
+void draw_restart_button(void)
+{
+    TRACE_SCOPE("draw_restart_button");
+    Rectangle button_rec = layout.restart_button;
+    bool hoverover = CheckCollisionPointRec(GetMousePosition(), button_rec);
+    // The button without hover is a part of the background
+    if (hoverover) render_restart_button(true);
+}
+
+
+// Everything that only changes with the window size, the board size or the
+// number of digits of the score: the board with its empty cells, the score
+// panel and the buttons without hover. Has to be called outside of
+// BeginDrawing()/EndDrawing().
+void update_background(void)
+{
+    Background_Key key = {
+        .width        = layout.screen_width,
+        .height       = layout.screen_height,
+        .board_size   = view->board_size,
+        .score_digits = count_digits(view->score),
+        .scale        = layout.scale,
+    };
+    if (key.width == background_key.width && key.height == background_key.height
+        && key.board_size == background_key.board_size
+        && key.score_digits == background_key.score_digits
+        && key.scale == background_key.scale) {
+        return;
+    }
+    if (background_key.width != 0) UnloadRenderTexture(background);
+    background_key = key;
+
+    background = LoadRenderTexture(key.width*key.scale, key.height*key.scale);
+    Camera2D camera = {.zoom = key.scale};
+    BeginTextureMode(background);
+    BeginMode2D(camera);
+        ClearBackground(BACKGROUND_COLOR);
+
+        Rectangle board_rec = layout.board;
+        draw_shadow_rec(board_rec, BOARD_SHADOW_COLOR);
+        DrawRectangleRec(board_rec, BOARD_COLOR);
+        for (int cy = 0; cy < key.board_size; cy++) {
+            for (int cx = 0; cx < key.board_size; cx++) {
+                Rectangle cell_rect = {layout.cells[cy][cx].x, layout.cells[cy][cx].y, CELL_SIZE, CELL_SIZE};
+                DrawRectangleRounded(cell_rect, ROUNDNESS, 0, EMPTY_CELL_COLOR);
+            }
+        }
+
+        int sx = layout.score_panel.x;
+        int sy = layout.score_panel.y;
+        int score_width = score_panel_width(key.score_digits);
+        Vector2 text_size = MeasureTextEx(score_label_font, "Score", SCORE_LABEL_TEXT_SIZE, 1);
+        Vector2 pos = {.x = sx + score_width/2 - text_size.x/2, .y = sy};
+        draw_shadow(sx, sy, score_width, SCORE_HEIGHT, BOARD_SHADOW_COLOR);
+        DrawRectangle(sx, sy, score_width, SCORE_HEIGHT, BOARD_COLOR);
+        DrawTextEx(score_label_font, "Score", pos, SCORE_LABEL_TEXT_SIZE, 1, TEXT_COLOR);
+
+        draw_shadow_rec(layout.restart_button, BOARD_SHADOW_COLOR);
+        render_restart_button(false);
+        draw_shadow_rec(layout.cancel_move_button, BOARD_SHADOW_COLOR);
+        render_cancel_move_button(false);
+    EndMode2D();
+    EndTextureMode();
+}
+
+
+void draw_background(void)
+{
+    Rectangle source = {0, 0, background.texture.width, -background.texture.height};
+    Rectangle dest = {0, 0, background_key.width, background_key.height};
+    DrawTexturePro(background.texture, source, dest, (Vector2){0, 0}, 0.0f, WHITE);
+}
+
+
+// Counts the frames that were not drawn while the loop was waiting for input
+void count_idle_frames(void)
+{
+    double now = GetTime();
+    if (idle) {
+        long long skipped = (long long)((now - last_frame_time)*TARGET_FPS) - 1;
+        if (skipped < 0) skipped = 0;
+        idle_skipped_frames += skipped;
+        profiler_idle_frames(skipped);
+    }
+    last_frame_time = now;
+}
+
+
+void update_idle_mode(void)
+{
+    Vector2 mouse = GetMousePosition();
+    bool hovered = CheckCollisionPointRec(mouse, layout.restart_button)
+        || CheckCollisionPointRec(mouse, layout.cancel_move_button);
+    // Commands that the snapshot does not reflect yet will change the screen
+    bool should_idle = view->at_rest && view->commands_done == simulation_commands_sent() && !hovered && !grid;
+    // The hints update as the search gets deeper
+    if (hints_wanted()) {
+        Ai_Result result;
+        ai_result(&result);
+        if (!result.done) should_idle = false;
+    }
+    if (should_idle == idle) return;
+
+    idle = should_idle;
+    if (idle) {
+        EnableEventWaiting();
+    } else {
+        DisableEventWaiting();
+    }
+}
+
+
+// Measured up to the return of EndDrawing(), which also covers the wait for
+// the frame limit
+void report_input_latency(void)
+{
+    double now = GetTime();
+    double time;
+    while (simulation_shown_input(view->sequence, &time)) {
+        profiler_input_latency(now - time);
     }
 }
 
 
 void game_frame(void)
 {
+    TRACE_SCOPE("game_frame");
+    count_idle_frames();
+    profiler_begin_frame();
+
+    capture_input();
+    profiler_end_stage(STAGE_CAPTURE_INPUT);
+
+    TRACE_BEGIN("process_moves");
+    simulation_update();
+    view = simulation_snapshot();
+    if (grid) {
+        spectator_update();
+        grid_view = spectator_snapshot();
+    } else {
+        if (view->board_size != window_board_size) resize_window();
+        update_hints();
+    }
+    update_layout();
+    TRACE_END("process_moves");
+    profiler_end_stage(STAGE_PROCESS_MOVES);
+
+    if (grid) {
+        update_grid_atlas();
+    } else {
+        update_tile_atlas();
+        update_background();
+    }
     BeginDrawing();
+    if (grid) {
         ClearBackground(BACKGROUND_COLOR);
+        draw_grid();
+        profiler_end_stage(STAGE_DRAW_BOARD);
+    } else {
+        draw_background();
 
         draw_board();
+        draw_hints();
+        draw_autoplay();
+        profiler_end_stage(STAGE_DRAW_BOARD);
         draw_score();
+        profiler_end_stage(STAGE_DRAW_SCORE);
         draw_restart_button();
+        profiler_end_stage(STAGE_DRAW_RESTART_BUTTON);
         draw_cancel_move_button();
+        profiler_end_stage(STAGE_DRAW_CANCEL_MOVE_BUTTON);
+    }
 
-        capture_input();
-
-        if (game_state == GAME_PLAY) {
-            Move move;
-            if (dequeue_move(&move)) {
-            switch (move) {
-                case MOVE_RIGHT: {
-                    save_back_board();
-                    save_prev_board();
-                    if (swipe_board_right()) {
-                        game_state = GAME_MOVE_CELLS_RIGHT;
-                    }
-                } break;
-                case MOVE_DOWN: {
-                    save_back_board();
-                    save_prev_board();
-                    if (swipe_board_down()) {
-                        game_state = GAME_MOVE_CELLS_DOWN;
-                    }
-                } break;
-                case MOVE_LEFT: {
-                    save_back_board();
-                    save_prev_board();
-                    if (swipe_board_left()) {
-                        game_state = GAME_MOVE_CELLS_LEFT;
-                    }
-                } break;
-                case MOVE_UP: {
-                    save_back_board();
-                    save_prev_board();
-                    if (swipe_board_up()) {
-                        game_state = GAME_MOVE_CELLS_UP;
-                    }
-                } break;
-                default: break;
-            }
-            }
-        } else {
-            game_time += GetFrameTime();
-            if (game_time > max_time) {
-                add_random_cell();
-                save_back_board();
-                game_state = GAME_PLAY;
-                game_time = 0.0f;
-            }
-        }
+    profiler_draw_overlay();
+    profiler_end_stage(STAGE_OVERLAY);
+    TRACE_BEGIN("present");
     EndDrawing();
+    TRACE_END("present");
+    report_input_latency();
+    profiler_end_stage(STAGE_PRESENT);
+    profiler_end_frame();
+    update_idle_mode();
 }
 
 
+#ifdef PLATFORM_WEB
 int main(void)
 {
-#ifndef PLATFORM_WEB
+#else
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+            if (!set_board_size(atoi(argv[++i]))) {
+                fprintf(stderr, "ERROR: board size has to be between %d and %d\n", MIN_BOARD_SIZE, MAX_BOARD_SIZE);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-autoplay") == 0 && i + 1 < argc) {
+            const char *rate = argv[++i];
+            autoplay = true;
+            autoplay_rate_index = -1;
+            for (int r = 0; r < AUTOPLAY_RATE_COUNT; ++r) {
+                if (autoplay_rates[r] == AUTOPLAY_UNLIMITED ? strcmp(rate, "max") == 0 : autoplay_rates[r] == atoi(rate)) {
+                    autoplay_rate_index = r;
+                }
+            }
+            if (autoplay_rate_index < 0) {
+                fprintf(stderr, "ERROR: autoplay rate has to be one of 1, 2, 5, 10, 30, 100, 1000 or max\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-grid") == 0 && i + 1 < argc) {
+            int count = atoi(argv[++i]);
+            grid = true;
+            grid_count_index = -1;
+            for (int g = 0; g < GRID_COUNT_OPTIONS; ++g) {
+                if (grid_counts[g] == count) grid_count_index = g;
+            }
+            if (grid_count_index < 0) {
+                fprintf(stderr, "ERROR: grid size has to be one of 16, 36, 64, 100, 144, 196 or 256 games\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-grid-tile") == 0 && i + 1 < argc) {
+            grid_tile_size = atoi(argv[++i]);
+            if (grid_tile_size < GRID_MIN_TILE_SIZE || grid_tile_size > GRID_MAX_TILE_SIZE) {
+                fprintf(stderr, "ERROR: grid tile size has to be between %d and %d pixels\n", GRID_MIN_TILE_SIZE, GRID_MAX_TILE_SIZE);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [-size <%d..%d>] [-autoplay <moves per second|max>] [-grid <games>] [-grid-tile <pixels>]\n",
+                    argv[0], MIN_BOARD_SIZE, MAX_BOARD_SIZE);
+            return 1;
+        }
+    }
+
     srand(time(0));
     SetTraceLogLevel(LOG_WARNING);
     SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_HIGHDPI);
 #endif
 
-    InitWindow(FIELD_WIDTH + FIELD_GAP*2, FIELD_HEIGHT + FIELD_GAP*2 + SCORE_HEIGHT, "2048");
-    SetTargetFPS(60);
+    build_palette();
+    simulation_init();
+    view = simulation_snapshot();
+    window_board_size = view->board_size;
+
+    InitWindow(FIELD_WIDTH(window_board_size) + FIELD_GAP*2, FIELD_HEIGHT(window_board_size) + FIELD_GAP*2 + SCORE_HEIGHT, "2048");
+    SetTargetFPS(TARGET_FPS);
+    update_layout();
 
     default_font = LoadFontEx(font_path, CELL_VALUE_DEFAULT_FONT_SIZE, NULL, 0);
     score_label_font = LoadFontEx(font_path, SCORE_LABEL_TEXT_SIZE, NULL, 0);
 
-    add_random_cell();
-    save_back_board();
-    save_prev_board();
+    simulation_start();
+    ai_start();
+    if (autoplay) send_autoplay(GetTime());
+    if (grid) set_grid(true);
 
 #ifdef PLATFORM_WEB
     raylib_js_set_entry(game_frame);
@@ -438,7 +1182,11 @@ int main(void)
     while(!WindowShouldClose()) {
         game_frame();
     }
+    spectator_stop();
+    ai_stop();
+    simulation_stop();
     CloseWindow();
+    printf("INFO: skipped %lld frames while waiting for input\n", idle_skipped_frames);
 #endif
 
     return 0;
@@ -0,0 +1,277 @@
+#include <math.h>
+#include "raylib.h"
+#include "profiler.h"
+#include "stb_sprintf.h"
+
+#ifndef PLATFORM_WEB
+    #include <stdio.h>
+#endif
+
+#define PROFILER_WINDOW 240
+#define PROFILER_LATENCY_WINDOW 240 // moves
+#define PROFILER_HISTOGRAM_BINS 40   // 1 ms each, the last one takes everything above
+#define PROFILER_DEADLINE_SLACK 1.25 // vsync jitter is not a missed frame
+#define PROFILER_LOG_PATH "frame_times.csv"
+
+#define OVERLAY_X 10
+#define OVERLAY_Y 10
+#define OVERLAY_WIDTH 300
+#define OVERLAY_LINE 16
+#define OVERLAY_FONT_SIZE 10
+#define OVERLAY_HISTOGRAM_HEIGHT 60
+#define OVERLAY_BACKGROUND (Color){0, 0, 0, 200}
+#define OVERLAY_TEXT_COLOR (Color){230, 230, 230, 255}
+#define OVERLAY_BAR_COLOR  (Color){100, 200, 100, 255}
+#define OVERLAY_MISS_COLOR (Color){220, 80, 80, 255}
+
+static const char *stage_names[STAGE_COUNT] = {
+    [STAGE_CAPTURE_INPUT]           = "capture_input",
+    [STAGE_PROCESS_MOVES]           = "process_moves",
+    [STAGE_DRAW_BOARD]              = "draw_board",
+    [STAGE_DRAW_SCORE]              = "draw_score",
+    [STAGE_DRAW_RESTART_BUTTON]     = "draw_restart_button",
+    [STAGE_DRAW_CANCEL_MOVE_BUTTON] = "draw_cancel_move_button",
+    [STAGE_OVERLAY]                 = "overlay",
+    [STAGE_PRESENT]                 = "present",
+};
+
+static bool enabled = false;
+static double deadline_ms = 1000.0/60.0;
+static double frame_start = 0.0;
+static double stage_start = 0.0;
+static double prev_frame_start = -1.0;
+static float prev_busy_ms = 0.0f; // the previous frame up to EndDrawing()
+static bool waited = false;       // blocked on input since the previous frame
+
+static float frame_ms[PROFILER_WINDOW] = {0};
+static float stage_ms[PROFILER_WINDOW][STAGE_COUNT] = {0};
+static float current_stage_ms[STAGE_COUNT] = {0};
+static int window_start = 0;
+static int window_size = 0;
+static long long frame_count = 0;
+static long long missed_frames = 0;
+static long long idle_frames = 0;
+
+static float latency_ms[PROFILER_LATENCY_WINDOW] = {0};
+static int latency_start = 0;
+static int latency_size = 0;
+
+#ifndef PLATFORM_WEB
+static FILE *log_file = NULL;
+#endif
+
+
+bool profiler_enabled(void)
+{
+    return enabled;
+}
+
+
+void profiler_toggle(int target_fps)
+{
+    enabled = !enabled;
+    deadline_ms = 1000.0/target_fps;
+    prev_frame_start = -1.0;
+    waited = false;
+    window_start = 0;
+    window_size = 0;
+    frame_count = 0;
+    missed_frames = 0;
+    idle_frames = 0;
+    latency_start = 0;
+    latency_size = 0;
+
+#ifndef PLATFORM_WEB
+    if (enabled) {
+        log_file = fopen(PROFILER_LOG_PATH, "w");
+        if (log_file != NULL) {
+            fprintf(log_file, "frame,frame_ms");
+            for (int i = 0; i < STAGE_COUNT; ++i) fprintf(log_file, ",%s", stage_names[i]);
+            fprintf(log_file, "\n");
+        }
+    } else if (log_file != NULL) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+#endif
+}
+
+
+void profiler_begin_frame(void)
+{
+    if (!enabled) return;
+    frame_start = GetTime();
+    stage_start = frame_start;
+    for (int i = 0; i < STAGE_COUNT; ++i) current_stage_ms[i] = 0.0f;
+}
+
+
+void profiler_end_stage(Stage stage)
+{
+    if (!enabled) return;
+    double now = GetTime();
+    current_stage_ms[stage] += (now - stage_start)*1000.0;
+    stage_start = now;
+}
+
+
+void profiler_end_frame(void)
+{
+    if (!enabled) return;
+
+    // The frame time is measured from frame start to frame start so it also
+    // covers the time spent outside of game_frame(). A wait for input happens
+    // inside EndDrawing(), after a frame it leaves only what the previous frame
+    // did itself, but no less than the budget the frame limit waits for anyway.
+    if (prev_frame_start >= 0.0) {
+        float ms = (frame_start - prev_frame_start)*1000.0;
+        if (waited) ms = fminf(ms, fmaxf(deadline_ms, prev_busy_ms));
+        int i = (window_start + window_size) % PROFILER_WINDOW;
+        if (window_size < PROFILER_WINDOW) {
+            window_size++;
+        } else {
+            window_start = (window_start + 1) % PROFILER_WINDOW;
+        }
+        frame_ms[i] = ms;
+        for (int s = 0; s < STAGE_COUNT; ++s) stage_ms[i][s] = current_stage_ms[s];
+
+        frame_count++;
+        if (ms > deadline_ms*PROFILER_DEADLINE_SLACK) missed_frames++;
+
+#ifndef PLATFORM_WEB
+        if (log_file != NULL) {
+            fprintf(log_file, "%lld,%.3f", frame_count, ms);
+            for (int s = 0; s < STAGE_COUNT; ++s) fprintf(log_file, ",%.3f", current_stage_ms[s]);
+            fprintf(log_file, "\n");
+        }
+#endif
+    }
+    prev_frame_start = frame_start;
+    prev_busy_ms = (stage_start - frame_start)*1000.0 - current_stage_ms[STAGE_PRESENT];
+    waited = false;
+}
+
+
+void profiler_idle_frames(long long frames)
+{
+    if (!enabled) return;
+    idle_frames += frames;
+    waited = true;
+}
+
+
+void profiler_input_latency(double seconds)
+{
+    if (!enabled) return;
+    int i = (latency_start + latency_size) % PROFILER_LATENCY_WINDOW;
+    if (latency_size < PROFILER_LATENCY_WINDOW) {
+        latency_size++;
+    } else {
+        latency_start = (latency_start + 1) % PROFILER_LATENCY_WINDOW;
+    }
+    latency_ms[i] = seconds*1000.0;
+}
+
+
+// Insertion sort, the windows are small and there is no qsort in the web build
+static void sort_window(const float *window, int capacity, int start, int size, float *sorted)
+{
+    for (int i = 0; i < size; ++i) {
+        float ms = window[(start + i) % capacity];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > ms) {
+            sorted[j] = sorted[j - 1];
+            --j;
+        }
+        sorted[j] = ms;
+    }
+}
+
+
+static float percentile(const float *sorted, int count, float p)
+{
+    if (count == 0) return 0.0f;
+    int i = (int)(p*(count - 1) + 0.5f);
+    return sorted[i];
+}
+
+
+void profiler_draw_overlay(void)
+{
+    if (!enabled) return;
+
+    static float sorted[PROFILER_WINDOW];
+    static float sorted_latency[PROFILER_LATENCY_WINDOW];
+    static char text[256];
+    static int histogram[PROFILER_HISTOGRAM_BINS];
+    static float average_stage_ms[STAGE_COUNT];
+    for (int i = 0; i < PROFILER_HISTOGRAM_BINS; ++i) histogram[i] = 0;
+    for (int s = 0; s < STAGE_COUNT; ++s) average_stage_ms[s] = 0.0f;
+
+    sort_window(frame_ms, PROFILER_WINDOW, window_start, window_size, sorted);
+    sort_window(latency_ms, PROFILER_LATENCY_WINDOW, latency_start, latency_size, sorted_latency);
+    for (int i = 0; i < window_size; ++i) {
+        float ms = frame_ms[(window_start + i) % PROFILER_WINDOW];
+        int bin = (int)ms;
+        if (bin >= PROFILER_HISTOGRAM_BINS) bin = PROFILER_HISTOGRAM_BINS - 1;
+        histogram[bin]++;
+
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            average_stage_ms[s] += stage_ms[(window_start + i) % PROFILER_WINDOW][s];
+        }
+    }
+
+    int lines = 5 + STAGE_COUNT;
+    int height = lines*OVERLAY_LINE + OVERLAY_HISTOGRAM_HEIGHT + OVERLAY_LINE;
+    DrawRectangle(OVERLAY_X, OVERLAY_Y, OVERLAY_WIDTH, height, OVERLAY_BACKGROUND);
+
+    int x = OVERLAY_X + 5;
+    int y = OVERLAY_Y + 5;
+    stbsp_snprintf(text, sizeof(text), "frame p50 %.2f  p99 %.2f  max %.2f ms",
+                   percentile(sorted, window_size, 0.50f),
+                   percentile(sorted, window_size, 0.99f),
+                   percentile(sorted, window_size, 1.00f));
+    DrawText(text, x, y, OVERLAY_FONT_SIZE, OVERLAY_TEXT_COLOR);
+    y += OVERLAY_LINE;
+
+    stbsp_snprintf(text, sizeof(text), "missed %lld of %lld frames (budget %.2f ms)",
+                   missed_frames, frame_count, deadline_ms);
+    DrawText(text, x, y, OVERLAY_FONT_SIZE, missed_frames > 0 ? OVERLAY_MISS_COLOR : OVERLAY_TEXT_COLOR);
+    y += OVERLAY_LINE;
+
+    stbsp_snprintf(text, sizeof(text), "input p50 %.2f  p99 %.2f  max %.2f ms (%d moves)",
+                   percentile(sorted_latency, latency_size, 0.50f),
+                   percentile(sorted_latency, latency_size, 0.99f),
+                   percentile(sorted_latency, latency_size, 1.00f),
+                   latency_size);
+    DrawText(text, x, y, OVERLAY_FONT_SIZE, OVERLAY_TEXT_COLOR);
+    y += OVERLAY_LINE;
+
+    stbsp_snprintf(text, sizeof(text), "skipped %lld frames waiting for input", idle_frames);
+    DrawText(text, x, y, OVERLAY_FONT_SIZE, OVERLAY_TEXT_COLOR);
+    y += OVERLAY_LINE;
+
+    DrawText("stage average ms", x, y, OVERLAY_FONT_SIZE, OVERLAY_TEXT_COLOR);
+    y += OVERLAY_LINE;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        float average = window_size > 0 ? average_stage_ms[s]/window_size : 0.0f;
+        stbsp_snprintf(text, sizeof(text), "  %-24s %.3f", stage_names[s], average);
+        DrawText(text, x, y, OVERLAY_FONT_SIZE, OVERLAY_TEXT_COLOR);
+        y += OVERLAY_LINE;
+    }
+
+    int max_count = 1;
+    for (int i = 0; i < PROFILER_HISTOGRAM_BINS; ++i) {
+        if (histogram[i] > max_count) max_count = histogram[i];
+    }
+    int bar_width = (OVERLAY_WIDTH - 10)/PROFILER_HISTOGRAM_BINS;
+    int bottom = y + OVERLAY_HISTOGRAM_HEIGHT;
+    for (int i = 0; i < PROFILER_HISTOGRAM_BINS; ++i) {
+        int bar_height = histogram[i]*OVERLAY_HISTOGRAM_HEIGHT/max_count;
+        Color color = i + 1 > deadline_ms*PROFILER_DEADLINE_SLACK ? OVERLAY_MISS_COLOR : OVERLAY_BAR_COLOR;
+        DrawRectangle(x + i*bar_width, bottom - bar_height, bar_width - 1, bar_height, color);
+    }
+    DrawText("0 ms", x, bottom + 2, OVERLAY_FONT_SIZE, OVERLAY_TEXT_COLOR);
+    stbsp_snprintf(text, sizeof(text), "%d+ ms", PROFILER_HISTOGRAM_BINS - 1);
+    DrawText(text, x + OVERLAY_WIDTH - 50, bottom + 2, OVERLAY_FONT_SIZE, OVERLAY_TEXT_COLOR);
+}
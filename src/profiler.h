@@ -0,0 +1,34 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdbool.h>
+
+// Per-frame timing of the stages of game_frame(). All of the functions are a
+// single branch when the profiler is disabled.
+
+typedef enum {
+    STAGE_CAPTURE_INPUT,
+    STAGE_PROCESS_MOVES,
+    STAGE_DRAW_BOARD,
+    STAGE_DRAW_SCORE,
+    STAGE_DRAW_RESTART_BUTTON,
+    STAGE_DRAW_CANCEL_MOVE_BUTTON,
+    STAGE_OVERLAY,
+    STAGE_PRESENT,
+    STAGE_COUNT,
+} Stage;
+
+void profiler_toggle(int target_fps);
+bool profiler_enabled(void);
+void profiler_begin_frame(void);
+void profiler_end_stage(Stage stage);
+void profiler_end_frame(void);
+// Called for every frame after the loop was blocked on input, with the frames
+// that were not drawn meanwhile. The wait is left out of the frame time so it
+// does not count as a missed frame, however short it was.
+void profiler_idle_frames(long long frames);
+// Time from polling a move to presenting the first frame that shows it
+void profiler_input_latency(double seconds);
+void profiler_draw_overlay(void);
+
+#endif // PROFILER_H_
@@ -0,0 +1,545 @@
+#include <stdatomic.h>
+#include "raylib.h"
+#include "ai.h"
+#include "simulation.h"
+#include "trace.h"
+
+#ifndef PLATFORM_WEB
+    #include <pthread.h>
+    #include <sched.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <time.h>
+#endif
+
+// The game logic advances in fixed steps of its own clock no matter how fast
+// or slow frames are drawn. Rendering extrapolates the animation from the
+// time of the snapshot it draws.
+#define LOGIC_HZ 240
+#define LOGIC_STEP (1.0/LOGIC_HZ)
+#define LOGIC_MAX_FRAME_TIME 0.25 // a stalled frame does not fast-forward the game
+
+#define MOVE_BUFFER_SIZE 100
+// With more moves than this waiting the game stops animating and catches up
+#define FAST_FORWARD_THRESHOLD 8
+
+#define COMMAND_QUEUE_SIZE 1024 // both queue sizes have to be powers of two
+#define SHOWN_INPUT_QUEUE_SIZE 256
+
+// Autoplay thinks for at most half of the time between two moves and
+// never longer than this
+#define AUTOPLAY_THINK_LIMIT 0.25
+#define AUTOPLAY_MIN_DEPTH 2
+#ifdef PLATFORM_WEB
+    // The search runs inside the frame
+    #define AUTOPLAY_THINK_LIMIT_WEB 0.008
+    #define AUTOPLAY_STEP_BUDGET 0.008
+#else
+    #define AUTOPLAY_STEP_BUDGET LOGIC_STEP
+#endif
+
+#define SNAPSHOT_FRESH 4u // set in snapshot_middle until the renderer takes it
+
+
+// Moves carry the time the input was polled so the time until their result
+// is presented can be measured. Autoplay moves have no input behind them and
+// are left out of that.
+typedef struct {
+    Move move;
+    double time;
+    bool from_input;
+} Queued_Move;
+
+typedef struct {
+    double time;
+    unsigned long long sequence;
+} Shown_Input;
+
+// The producer only writes the tail and the consumer only writes the head
+typedef struct {
+    Command items[COMMAND_QUEUE_SIZE];
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+} Command_Queue;
+
+typedef struct {
+    Shown_Input items[SHOWN_INPUT_QUEUE_SIZE];
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+} Shown_Input_Queue;
+
+
+// Owned by the simulation
+static State game_state = GAME_PLAY;
+static float game_time = 0.0f;
+static float max_time = 0.1f;
+static float move_time = 0.1f; // max_time shortened by the number of waiting moves
+
+static double logic_time = -1.0;
+static double logic_accumulator = 0.0;
+
+static Queued_Move move_buffer[MOVE_BUFFER_SIZE] = {0};
+static int move_buffer_size = 0;
+static int move_buffer_start = 0;
+
+static int autoplay_rate = AUTOPLAY_OFF;
+static double autoplay_next = 0.0;
+static int autoplay_depth = 0;
+static unsigned long long autoplay_moves = 0;
+
+static unsigned long long commands_done = 0;
+static unsigned long long published_sequence = 0;
+static unsigned int snapshot_back = 0;
+
+// Owned by the renderer
+static unsigned long long commands_sent = 0;
+static unsigned int snapshot_front = 2;
+
+// Shared
+static Command_Queue commands = {0};
+static Shown_Input_Queue shown_inputs = {0};
+static Snapshot snapshots[3] = {0};
+static atomic_uint snapshot_middle = 1;
+
+#ifndef PLATFORM_WEB
+static pthread_t thread;
+static pthread_mutex_t wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static atomic_bool quit = false;
+#endif
+
+
+static bool push_command(Command command)
+{
+    unsigned int tail = atomic_load_explicit(&commands.tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&commands.head, memory_order_acquire);
+    if (tail - head == COMMAND_QUEUE_SIZE) return false;
+    commands.items[tail % COMMAND_QUEUE_SIZE] = command;
+    atomic_store_explicit(&commands.tail, tail + 1, memory_order_release);
+    return true;
+}
+
+
+static bool pop_command(Command *command)
+{
+    unsigned int head = atomic_load_explicit(&commands.head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&commands.tail, memory_order_acquire);
+    if (head == tail) return false;
+    *command = commands.items[head % COMMAND_QUEUE_SIZE];
+    atomic_store_explicit(&commands.head, head + 1, memory_order_release);
+    return true;
+}
+
+
+static bool has_commands(void)
+{
+    return atomic_load_explicit(&commands.head, memory_order_relaxed)
+        != atomic_load_explicit(&commands.tail, memory_order_acquire);
+}
+
+
+// Latency samples are only metrics, they are dropped when the renderer falls behind
+static void input_shown(double time)
+{
+    unsigned int tail = atomic_load_explicit(&shown_inputs.tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&shown_inputs.head, memory_order_acquire);
+    if (tail - head == SHOWN_INPUT_QUEUE_SIZE) return;
+    shown_inputs.items[tail % SHOWN_INPUT_QUEUE_SIZE] = (Shown_Input){time, published_sequence + 1};
+    atomic_store_explicit(&shown_inputs.tail, tail + 1, memory_order_release);
+}
+
+
+bool simulation_shown_input(unsigned long long sequence, double *time)
+{
+    unsigned int head = atomic_load_explicit(&shown_inputs.head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&shown_inputs.tail, memory_order_acquire);
+    if (head == tail) return false;
+    Shown_Input *shown = &shown_inputs.items[head % SHOWN_INPUT_QUEUE_SIZE];
+    if (shown->sequence > sequence) return false;
+    *time = shown->time;
+    atomic_store_explicit(&shown_inputs.head, head + 1, memory_order_release);
+    return true;
+}
+
+
+static bool dequeue_move(Queued_Move *move)
+{
+    if (move_buffer_size == 0) return false;
+
+    *move = move_buffer[move_buffer_start];
+    move_buffer_size--;
+    move_buffer_start = (move_buffer_start + 1) % MOVE_BUFFER_SIZE;
+    return true;
+}
+
+
+static bool swipe_board(Move move)
+{
+    switch (move) {
+        case MOVE_RIGHT: return swipe_board_right();
+        case MOVE_DOWN:  return swipe_board_down();
+        case MOVE_LEFT:  return swipe_board_left();
+        case MOVE_UP:    return swipe_board_up();
+        default:         return false;
+    }
+}
+
+
+static void start_move(Queued_Move queued)
+{
+    static const State move_states[] = {
+        [MOVE_LEFT]  = GAME_MOVE_CELLS_LEFT,
+        [MOVE_DOWN]  = GAME_MOVE_CELLS_DOWN,
+        [MOVE_RIGHT] = GAME_MOVE_CELLS_RIGHT,
+        [MOVE_UP]    = GAME_MOVE_CELLS_UP,
+    };
+
+    save_back_board();
+    save_prev_board();
+    if (swipe_board(queued.move)) {
+        // The new cell is hidden in back_board until the animation ends, adding
+        // it now lets the successors of the next position be computed meanwhile
+        add_random_cell();
+        if (queued.from_input) input_shown(queued.time);
+        game_state = move_states[queued.move];
+        // The more moves are waiting the faster this one is animated
+        move_time = max_time/(1 + move_buffer_size);
+    }
+}
+
+
+static void finish_move(void)
+{
+    save_back_board();
+    game_state = GAME_PLAY;
+    game_time = 0.0f;
+}
+
+
+// Applies the move right away without animating it
+static void apply_move(Queued_Move queued)
+{
+    if (game_state != GAME_PLAY) finish_move();
+    save_prev_board();
+    if (swipe_board(queued.move)) {
+        if (queued.from_input) input_shown(queued.time);
+        add_random_cell();
+    }
+    save_back_board();
+}
+
+
+static void queue_move(Queued_Move move)
+{
+    // A full queue makes room by applying its oldest move, moves are never dropped
+    if (move_buffer_size == MOVE_BUFFER_SIZE) {
+        Queued_Move oldest;
+        dequeue_move(&oldest);
+        apply_move(oldest);
+    }
+    move_buffer[(move_buffer_start + move_buffer_size) % MOVE_BUFFER_SIZE] = move;
+    move_buffer_size++;
+}
+
+
+static void restart_game(void)
+{
+    clear_board();
+    add_random_cell();
+    save_prev_board();
+    save_back_board();
+    Queued_Move move;
+    while (dequeue_move(&move) == true);
+    reset_score();
+    game_state = GAME_PLAY;
+    game_time = 0.0f;
+}
+
+
+static void run_command(Command command)
+{
+    switch (command.kind) {
+        case COMMAND_MOVE: {
+            queue_move((Queued_Move){command.arg, command.time, true});
+        } break;
+        case COMMAND_RESTART: {
+            restart_game();
+        } break;
+        case COMMAND_CANCEL_MOVE: {
+            cancel_move();
+        } break;
+        case COMMAND_SET_BOARD_SIZE: {
+            if (set_board_size(command.arg)) restart_game();
+        } break;
+        case COMMAND_SET_AUTOPLAY: {
+            autoplay_rate = command.arg;
+            autoplay_next = 0.0;
+        } break;
+        default: break;
+    }
+    commands_done++;
+}
+
+
+// One fixed step of the game logic
+static void logic_step(void)
+{
+    // Too far behind to animate: catch up in this step and animate only the
+    // last waiting move
+    if (move_buffer_size > FAST_FORWARD_THRESHOLD) {
+        Queued_Move move;
+        while (move_buffer_size > 1 && dequeue_move(&move)) apply_move(move);
+    }
+
+    if (game_state == GAME_PLAY) {
+        Queued_Move move;
+        if (dequeue_move(&move)) start_move(move);
+    } else {
+        game_time += LOGIC_STEP;
+        if (game_time > move_time) finish_move();
+    }
+
+    // Swiping is a copy when the next move arrives
+    precompute_successors();
+}
+
+
+static bool logic_at_rest(void)
+{
+    return game_state == GAME_PLAY && move_buffer_size == 0;
+}
+
+
+// Nothing will change until a command comes in: no autoplay, or an autoplay
+// that has lost its game
+static bool logic_idle(void)
+{
+    return logic_at_rest() && (autoplay_rate == AUTOPLAY_OFF || is_game_over());
+}
+
+
+// Searches the board at rest and plays the move it finds, returns false when
+// the game is over
+static bool autoplay_move(bool animate, double deadline)
+{
+    static int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    int size = get_board_size();
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            cells[y][x] = cell_at(x, y);
+        }
+    }
+
+    int depth;
+    int move = ai_choose_move((const int (*)[MAX_BOARD_SIZE])cells, size, AUTOPLAY_MIN_DEPTH, deadline, &depth);
+    if (move < 0) return false;
+    autoplay_depth = depth;
+
+    Queued_Move queued = {move, GetTime(), false};
+    if (animate) {
+        queue_move(queued);
+    } else {
+        apply_move(queued);
+    }
+    autoplay_moves++;
+    return true;
+}
+
+
+// Moves that come faster than their animation are not animated, and the
+// unlimited rate plays as many as fit into one step. Frames then show only
+// the latest of the states, so drawing never holds the game back.
+static void update_autoplay(void)
+{
+    if (autoplay_rate == AUTOPLAY_OFF) return;
+    TRACE_SCOPE("autoplay");
+    double now = GetTime();
+
+    if (autoplay_rate == AUTOPLAY_UNLIMITED) {
+        if (game_state != GAME_PLAY) finish_move();
+        double deadline = now + AUTOPLAY_STEP_BUDGET;
+        while (GetTime() < deadline && autoplay_move(false, 0.0));
+        return;
+    }
+
+    if (!logic_at_rest() || now < autoplay_next) return;
+    double interval = 1.0/autoplay_rate;
+    // Catching up after a stall would only burst moves out
+    autoplay_next = autoplay_next + interval < now ? now + interval : autoplay_next + interval;
+
+    double think = interval/2 < AUTOPLAY_THINK_LIMIT ? interval/2 : AUTOPLAY_THINK_LIMIT;
+#ifdef PLATFORM_WEB
+    if (think > AUTOPLAY_THINK_LIMIT_WEB) think = AUTOPLAY_THINK_LIMIT_WEB;
+#endif
+    autoplay_move(interval >= max_time, now + think);
+}
+
+
+static void update_logic(void)
+{
+    double now = GetTime();
+    double elapsed = logic_time < 0.0 ? 0.0 : now - logic_time;
+    logic_time = now;
+    if (elapsed > LOGIC_MAX_FRAME_TIME) elapsed = LOGIC_MAX_FRAME_TIME;
+
+    logic_accumulator += elapsed;
+    // Nothing changes while the logic is at rest, so the time spent there is
+    // not simulated and a new move starts on the frame it arrives in
+    if (logic_at_rest() && logic_accumulator > LOGIC_STEP) logic_accumulator = LOGIC_STEP;
+    while (logic_accumulator >= LOGIC_STEP) {
+        logic_step();
+        logic_accumulator -= LOGIC_STEP;
+        if (logic_at_rest()) logic_accumulator = 0.0;
+    }
+}
+
+
+static void publish_snapshot(void)
+{
+    Snapshot *snapshot = &snapshots[snapshot_back];
+    int size = get_board_size();
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            snapshot->cells[y][x] = cell_at(x, y);
+            snapshot->movement[y][x] = movement_at(x, y);
+        }
+    }
+    snapshot->board_size = size;
+    snapshot->score = get_score();
+    snapshot->state = game_state;
+    snapshot->game_time = game_time;
+    snapshot->move_time = move_time;
+    snapshot->time = logic_time - logic_accumulator;
+    snapshot->at_rest = logic_idle();
+    snapshot->game_over = game_state == GAME_PLAY && is_game_over();
+    snapshot->autoplay_rate = autoplay_rate;
+    snapshot->autoplay_depth = autoplay_depth;
+    snapshot->autoplay_moves = autoplay_moves;
+    snapshot->commands_done = commands_done;
+    snapshot->sequence = ++published_sequence;
+
+    unsigned int previous = atomic_exchange_explicit(&snapshot_middle, snapshot_back | SNAPSHOT_FRESH, memory_order_acq_rel);
+    snapshot_back = previous & ~SNAPSHOT_FRESH;
+}
+
+
+static void step_simulation(void)
+{
+    TRACE_SCOPE("simulation_step");
+    Command command;
+    while (pop_command(&command)) run_command(command);
+    update_autoplay();
+    update_logic();
+    publish_snapshot();
+}
+
+
+const Snapshot *simulation_snapshot(void)
+{
+    if (atomic_load_explicit(&snapshot_middle, memory_order_relaxed) & SNAPSHOT_FRESH) {
+        unsigned int previous = atomic_exchange_explicit(&snapshot_middle, snapshot_front, memory_order_acq_rel);
+        snapshot_front = previous & ~SNAPSHOT_FRESH;
+    }
+    return &snapshots[snapshot_front];
+}
+
+
+unsigned long long simulation_commands_sent(void)
+{
+    return commands_sent;
+}
+
+
+void simulation_init(void)
+{
+    restart_game();
+    publish_snapshot();
+}
+
+
+#ifdef PLATFORM_WEB
+
+void simulation_start(void)
+{
+}
+
+
+void simulation_stop(void)
+{
+}
+
+
+void simulation_update(void)
+{
+    step_simulation();
+}
+
+
+void simulation_send(Command command)
+{
+    if (!push_command(command)) {
+        step_simulation();
+        push_command(command);
+    }
+    commands_sent++;
+}
+
+#else
+
+static void *simulation_thread(void *arg)
+{
+    (void)arg;
+    TRACE_THREAD_NAME("simulation");
+    while (!atomic_load(&quit)) {
+        step_simulation();
+        if (logic_idle()) {
+            // Nothing to animate, sleep until the renderer sends a command
+            pthread_mutex_lock(&wake_mutex);
+            while (!atomic_load(&quit) && !has_commands()) pthread_cond_wait(&wake, &wake_mutex);
+            pthread_mutex_unlock(&wake_mutex);
+        } else if (autoplay_rate != AUTOPLAY_UNLIMITED) {
+            // The unlimited autoplay has just spent a whole step playing
+            struct timespec step = {.tv_sec = 0, .tv_nsec = LOGIC_STEP*1e9};
+            nanosleep(&step, NULL);
+        }
+    }
+    TRACE_THREAD_EXIT();
+    return NULL;
+}
+
+
+void simulation_start(void)
+{
+    if (pthread_create(&thread, NULL, simulation_thread, NULL) != 0) {
+        fprintf(stderr, "ERROR: could not start the simulation thread\n");
+        exit(1);
+    }
+}
+
+
+void simulation_stop(void)
+{
+    pthread_mutex_lock(&wake_mutex);
+    atomic_store(&quit, true);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&wake_mutex);
+    pthread_join(thread, NULL);
+}
+
+
+void simulation_update(void)
+{
+}
+
+
+void simulation_send(Command command)
+{
+    while (!push_command(command)) sched_yield();
+    commands_sent++;
+
+    pthread_mutex_lock(&wake_mutex);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&wake_mutex);
+}
+
+#endif // PLATFORM_WEB
@@ -0,0 +1,79 @@
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include <stdbool.h>
+#include "2048.h"
+
+// The game logic of the GUI. Natively it runs on its own thread and talks to
+// the render thread through two lock-free single producer single consumer
+// queues and a triple buffer of snapshots, so drawing never waits on the
+// engine. The web build has no threads and runs the same logic inline from
+// simulation_update().
+
+typedef enum {
+    GAME_PLAY,
+    GAME_MOVE_CELLS_LEFT,
+    GAME_MOVE_CELLS_RIGHT,
+    GAME_MOVE_CELLS_DOWN,
+    GAME_MOVE_CELLS_UP,
+} State;
+
+typedef enum {
+    MOVE_LEFT,
+    MOVE_DOWN,
+    MOVE_RIGHT,
+    MOVE_UP,
+} Move;
+
+typedef enum {
+    COMMAND_MOVE,
+    COMMAND_RESTART,
+    COMMAND_CANCEL_MOVE,
+    COMMAND_SET_BOARD_SIZE,
+    COMMAND_SET_AUTOPLAY,
+} Command_Kind;
+
+// Autoplay rates besides moves per second
+#define AUTOPLAY_OFF 0
+#define AUTOPLAY_UNLIMITED -1
+
+typedef struct {
+    Command_Kind kind;
+    int arg;     // the Move, the board size or the autoplay rate
+    double time; // GetTime() when the input was polled
+} Command;
+
+// Everything the render thread needs to draw a frame
+typedef struct {
+    int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE]; // the board before the running move
+    int movement[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    int board_size;
+    long long score;
+    State state;
+    float game_time;
+    float move_time;
+    double time; // GetTime() the snapshot corresponds to, drawing extrapolates the animation from it
+    bool at_rest;
+    bool game_over;
+    int autoplay_rate;
+    int autoplay_depth; // of the search behind the last autoplay move
+    unsigned long long autoplay_moves;
+    unsigned long long commands_done;
+    unsigned long long sequence;
+} Snapshot;
+
+// Sets up the first game and publishes its snapshot
+void simulation_init(void);
+// Needs the window, the logic clock is GetTime()
+void simulation_start(void);
+void simulation_stop(void);
+// Runs the logic on the calling thread, does nothing when it has its own thread
+void simulation_update(void);
+void simulation_send(Command command);
+unsigned long long simulation_commands_sent(void);
+// The latest published snapshot, valid until the next call
+const Snapshot *simulation_snapshot(void);
+// Input times of the moves that first show up in the snapshot `sequence` or earlier
+bool simulation_shown_input(unsigned long long sequence, double *time);
+
+#endif // SIMULATION_H_
@@ -0,0 +1,530 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "tablebase.h"
+#include "trace.h"
+
+// Exact solver for small boards (2x2, 2x3, 3x3, 2x4, ...).
+//
+// The state space is enumerated forward layer by layer (a layer holds the
+// states with the same sum of tiles, so every child of layer k is in layer
+// k+1 or k+2), deduplicated with a bitset that has one bit per possible
+// board. Then the values are computed backward starting from the last
+// layer (retrograde analysis) and written to a tablebase that can be
+// mapped with tablebase_open(). Both passes split every big layer between
+// the threads of a worker pool that lives for the whole run.
+
+#define MIN_PARALLEL_STATES 4096
+#define MAX_VISITED_BITS (1ull << 35)
+
+typedef enum {
+    DIR_LEFT,
+    DIR_RIGHT,
+    DIR_UP,
+    DIR_DOWN,
+    DIR_COUNT,
+} Dir;
+
+typedef struct {
+    uint64_t *states;
+    float    *values;
+    size_t    count;
+    size_t    capacity;
+} Layer;
+
+typedef struct Worker Worker;
+
+typedef struct {
+    int rows;
+    int cols;
+    int cells;
+    int target;
+    Tablebase_Mode mode;
+    int line_count[DIR_COUNT];
+    int line_length[DIR_COUNT];
+    int lines[DIR_COUNT][TABLEBASE_MAX_CELLS];
+    uint64_t *visited;
+    Layer *layers;
+    size_t layer_count;
+
+    // Worker pool
+    int thread_count;
+    Worker *workers;
+    pthread_t *threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    void (*job)(Worker *w);
+    unsigned job_generation;
+    int job_active;
+    bool quit;
+} Solver;
+
+struct Worker {
+    Solver *solver;
+    size_t k;
+    size_t begin;
+    size_t end;
+    Layer children[2]; // new states of layers k+1 and k+2
+};
+
+
+static void layer_push(Layer *layer, uint64_t state)
+{
+    if (layer->count >= layer->capacity) {
+        layer->capacity = layer->capacity == 0 ? 256 : layer->capacity*2;
+        layer->states = realloc(layer->states, layer->capacity*sizeof(*layer->states));
+        if (layer->states == NULL) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+    }
+    layer->states[layer->count++] = state;
+}
+
+
+static int cell_get(uint64_t state, int cell)
+{
+    return (state >> (4*cell)) & 0xF;
+}
+
+
+static uint64_t cell_set(uint64_t state, int cell, int exponent)
+{
+    return state | ((uint64_t)exponent << (4*cell));
+}
+
+
+static void solver_init_lines(Solver *s)
+{
+    for (int dir = 0; dir < DIR_COUNT; ++dir) {
+        bool horizontal = dir == DIR_LEFT || dir == DIR_RIGHT;
+        bool reversed = dir == DIR_RIGHT || dir == DIR_DOWN;
+        s->line_count[dir]  = horizontal ? s->rows : s->cols;
+        s->line_length[dir] = horizontal ? s->cols : s->rows;
+        for (int l = 0; l < s->line_count[dir]; ++l) {
+            for (int i = 0; i < s->line_length[dir]; ++i) {
+                int j = reversed ? s->line_length[dir] - 1 - i : i;
+                int cell = horizontal ? l*s->cols + j : j*s->cols + l;
+                s->lines[dir][l*s->line_length[dir] + i] = cell;
+            }
+        }
+    }
+}
+
+
+// Slide and merge every line towards its first cell
+static uint64_t solver_move(const Solver *s, uint64_t state, Dir dir, uint32_t *reward)
+{
+    uint64_t result = 0;
+    *reward = 0;
+    for (int l = 0; l < s->line_count[dir]; ++l) {
+        const int *line = &s->lines[dir][l*s->line_length[dir]];
+        int out = 0;
+        int pending = 0;
+        for (int i = 0; i < s->line_length[dir]; ++i) {
+            int exponent = cell_get(state, line[i]);
+            if (exponent == 0) continue;
+            if (exponent == pending) {
+                result = cell_set(result, line[out++], exponent + 1);
+                *reward += 1u << (exponent + 1);
+                pending = 0;
+            } else {
+                if (pending != 0) result = cell_set(result, line[out++], pending);
+                pending = exponent;
+            }
+        }
+        if (pending != 0) result = cell_set(result, line[out], pending);
+    }
+    return result;
+}
+
+
+static bool solver_has_target(const Solver *s, uint64_t state)
+{
+    for (int cell = 0; cell < s->cells; ++cell) {
+        if (cell_get(state, cell) >= s->target) return true;
+    }
+    return false;
+}
+
+
+static uint64_t solver_index(const Solver *s, uint64_t state)
+{
+    uint64_t index = 0;
+    for (int cell = s->cells - 1; cell >= 0; --cell) {
+        index = index*s->target + cell_get(state, cell);
+    }
+    return index;
+}
+
+
+// Returns true if the state was not visited before
+static bool solver_visit(Solver *s, uint64_t state)
+{
+    uint64_t index = solver_index(s, state);
+    uint64_t mask = 1ull << (index%64);
+    uint64_t old = __atomic_fetch_or(&s->visited[index/64], mask, __ATOMIC_RELAXED);
+    return (old & mask) == 0;
+}
+
+
+static float solver_value_of(const Solver *s, size_t k, uint64_t state)
+{
+    const Layer *layer = &s->layers[k];
+    size_t lo = 0;
+    size_t hi = layer->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (layer->states[mid] < state) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == layer->count || layer->states[lo] != state) {
+        fprintf(stderr, "ERROR: state %016llx is missing from layer %zu\n", (unsigned long long)state, k);
+        exit(1);
+    }
+    return layer->values[lo];
+}
+
+
+static void expand_states(Worker *w)
+{
+    TRACE_SCOPE("expand_states");
+    Solver *s = w->solver;
+    const Layer *layer = &s->layers[w->k];
+
+    for (size_t i = w->begin; i < w->end; ++i) {
+        uint64_t state = layer->states[i];
+        for (int dir = 0; dir < DIR_COUNT; ++dir) {
+            uint32_t reward;
+            uint64_t after = solver_move(s, state, dir, &reward);
+            if (after == state || solver_has_target(s, after)) continue;
+
+            for (int cell = 0; cell < s->cells; ++cell) {
+                if (cell_get(after, cell) != 0) continue;
+                for (int spawn = 1; spawn <= 2; ++spawn) {
+                    uint64_t child = cell_set(after, cell, spawn);
+                    if (solver_visit(s, child)) layer_push(&w->children[spawn - 1], child);
+                }
+            }
+        }
+    }
+}
+
+
+static void evaluate_states(Worker *w)
+{
+    TRACE_SCOPE("evaluate_states");
+    Solver *s = w->solver;
+    Layer *layer = &s->layers[w->k];
+
+    for (size_t i = w->begin; i < w->end; ++i) {
+        uint64_t state = layer->states[i];
+        double best = 0.0;
+        for (int dir = 0; dir < DIR_COUNT; ++dir) {
+            uint32_t reward;
+            uint64_t after = solver_move(s, state, dir, &reward);
+            if (after == state) continue;
+
+            double value = s->mode == TABLEBASE_SCORE ? reward : 0.0;
+            if (solver_has_target(s, after)) {
+                if (s->mode == TABLEBASE_WIN) value = 1.0;
+            } else {
+                double expected = 0.0;
+                int empty = 0;
+                for (int cell = 0; cell < s->cells; ++cell) {
+                    if (cell_get(after, cell) != 0) continue;
+                    expected += 0.9*solver_value_of(s, w->k + 1, cell_set(after, cell, 1));
+                    expected += 0.1*solver_value_of(s, w->k + 2, cell_set(after, cell, 2));
+                    ++empty;
+                }
+                value += expected/empty;
+            }
+            if (value > best) best = value;
+        }
+        layer->values[i] = best;
+    }
+}
+
+
+static void *pool_thread(void *arg)
+{
+    Worker *w = arg;
+    Solver *s = w->solver;
+    unsigned seen = 0;
+    TRACE_THREAD_NAME("solver worker");
+
+    for (;;) {
+        pthread_mutex_lock(&s->mutex);
+        while (s->job_generation == seen && !s->quit) pthread_cond_wait(&s->job_ready, &s->mutex);
+        if (s->quit) {
+            pthread_mutex_unlock(&s->mutex);
+            TRACE_THREAD_EXIT();
+            return NULL;
+        }
+        seen = s->job_generation;
+        void (*job)(Worker *w) = s->job;
+        pthread_mutex_unlock(&s->mutex);
+
+        job(w);
+
+        pthread_mutex_lock(&s->mutex);
+        if (--s->job_active == 0) pthread_cond_signal(&s->job_done);
+        pthread_mutex_unlock(&s->mutex);
+    }
+}
+
+
+static void pool_start(Solver *s)
+{
+    s->workers = calloc(s->thread_count, sizeof(*s->workers));
+    s->threads = calloc(s->thread_count, sizeof(*s->threads));
+    if (s->workers == NULL || s->threads == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->job_ready, NULL);
+    pthread_cond_init(&s->job_done, NULL);
+
+    for (int t = 0; t < s->thread_count; ++t) {
+        s->workers[t].solver = s;
+        if (pthread_create(&s->threads[t], NULL, pool_thread, &s->workers[t]) != 0) {
+            fprintf(stderr, "ERROR: could not create a worker thread\n");
+            exit(1);
+        }
+    }
+}
+
+
+static void pool_stop(Solver *s)
+{
+    pthread_mutex_lock(&s->mutex);
+    s->quit = true;
+    pthread_cond_broadcast(&s->job_ready);
+    pthread_mutex_unlock(&s->mutex);
+    for (int t = 0; t < s->thread_count; ++t) {
+        pthread_join(s->threads[t], NULL);
+    }
+}
+
+
+// Split layer k between the workers, small layers are done on the calling thread
+static void run_workers(Solver *s, size_t k, void (*job)(Worker *w))
+{
+    size_t count = s->layers[k].count;
+    int thread_count = count < MIN_PARALLEL_STATES ? 1 : s->thread_count;
+
+    for (int t = 0; t < s->thread_count; ++t) {
+        Worker *w = &s->workers[t];
+        w->k = k;
+        w->begin = t < thread_count ? count*t/thread_count : 0;
+        w->end = t < thread_count ? count*(t + 1)/thread_count : 0;
+        w->children[0].count = 0;
+        w->children[1].count = 0;
+    }
+
+    if (thread_count == 1) {
+        job(&s->workers[0]);
+        return;
+    }
+
+    pthread_mutex_lock(&s->mutex);
+    s->job = job;
+    s->job_active = s->thread_count;
+    s->job_generation++;
+    pthread_cond_broadcast(&s->job_ready);
+    while (s->job_active > 0) pthread_cond_wait(&s->job_done, &s->mutex);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+
+static int compare_states(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+static size_t solver_enumerate(Solver *s)
+{
+    TRACE_SCOPE("solver_enumerate");
+    for (int cell = 0; cell < s->cells; ++cell) {
+        for (int spawn = 1; spawn <= 2; ++spawn) {
+            uint64_t state = cell_set(0, cell, spawn);
+            solver_visit(s, state);
+            layer_push(&s->layers[spawn], state);
+        }
+    }
+
+    size_t total = 0;
+    for (size_t k = 1; k < s->layer_count; ++k) {
+        Layer *layer = &s->layers[k];
+        if (layer->count == 0) continue;
+        qsort(layer->states, layer->count, sizeof(*layer->states), compare_states);
+        total += layer->count;
+
+        run_workers(s, k, expand_states);
+        for (int t = 0; t < s->thread_count; ++t) {
+            for (int c = 0; c < 2; ++c) {
+                const Layer *children = &s->workers[t].children[c];
+                for (size_t i = 0; i < children->count; ++i) {
+                    layer_push(&s->layers[k + 1 + c], children->states[i]);
+                }
+            }
+        }
+
+        if (k % 100 == 0) printf("INFO: enumerated layer %zu, %zu states so far\n", k, total);
+    }
+    return total;
+}
+
+
+static void solver_evaluate(Solver *s)
+{
+    TRACE_SCOPE("solver_evaluate");
+    for (size_t k = s->layer_count - 1; k > 0; --k) {
+        Layer *layer = &s->layers[k];
+        if (layer->count == 0) continue;
+        layer->values = malloc(layer->count*sizeof(*layer->values));
+        if (layer->values == NULL) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        run_workers(s, k, evaluate_states);
+        if (k % 100 == 0) printf("INFO: evaluated layer %zu\n", k);
+    }
+}
+
+
+static bool solver_write(const Solver *s, const char *path, size_t total)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: could not open %s for writing\n", path);
+        return false;
+    }
+
+    Tablebase_Header header = {0};
+    memcpy(header.magic, TABLEBASE_MAGIC, sizeof(TABLEBASE_MAGIC));
+    header.rows        = s->rows;
+    header.cols        = s->cols;
+    header.target      = s->target;
+    header.mode        = s->mode;
+    header.layer_count = s->layer_count;
+    header.state_count = total;
+    fwrite(&header, sizeof(header), 1, f);
+
+    uint64_t offset = 0;
+    for (size_t k = 0; k < s->layer_count; ++k) {
+        Tablebase_Layer layer = {.offset = offset, .count = s->layers[k].count};
+        fwrite(&layer, sizeof(layer), 1, f);
+        offset += layer.count;
+    }
+    for (size_t k = 0; k < s->layer_count; ++k) {
+        fwrite(s->layers[k].states, sizeof(uint64_t), s->layers[k].count, f);
+    }
+    for (size_t k = 0; k < s->layer_count; ++k) {
+        fwrite(s->layers[k].values, sizeof(float), s->layers[k].count, f);
+    }
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "ERROR: could not write %s\n", path);
+    return ok;
+}
+
+
+static int print_info(const char *path)
+{
+    Tablebase tb;
+    if (!tablebase_open(&tb, path)) return 1;
+    printf("Board:  %ux%u\n", tb.header->rows, tb.header->cols);
+    printf("Target: %u\n", 1u << tb.header->target);
+    printf("Mode:   %s\n", tb.header->mode == TABLEBASE_WIN ? "win" : "score");
+    printf("States: %llu\n", (unsigned long long)tb.header->state_count);
+    printf("Value:  %f\n", tablebase_start_value(&tb));
+    tablebase_close(&tb);
+    return 0;
+}
+
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s <rows> <cols> <target-tile> <win|score> <output.tb> [threads]\n", program);
+    fprintf(stderr, "       %s -info <input.tb>\n", program);
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "-info") == 0) return print_info(argv[2]);
+    if (argc != 6 && argc != 7) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Solver s = {0};
+    s.rows = atoi(argv[1]);
+    s.cols = atoi(argv[2]);
+    s.cells = s.rows*s.cols;
+    int target_tile = atoi(argv[3]);
+    while ((1 << s.target) < target_tile) ++s.target;
+    s.mode = strcmp(argv[4], "score") == 0 ? TABLEBASE_SCORE : TABLEBASE_WIN;
+    s.thread_count = argc == 7 ? atoi(argv[6]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (s.thread_count < 1) s.thread_count = 1;
+
+    if (s.rows < 1 || s.cols < 1 || s.cells < 2 || s.cells > TABLEBASE_MAX_CELLS) {
+        fprintf(stderr, "ERROR: boards have to have between 2 and %d cells\n", TABLEBASE_MAX_CELLS);
+        return 1;
+    }
+    if ((1 << s.target) != target_tile || s.target < 3 || s.target > TABLEBASE_MAX_EXPONENT) {
+        fprintf(stderr, "ERROR: target tile has to be a power of two between 8 and %d\n", 1 << TABLEBASE_MAX_EXPONENT);
+        return 1;
+    }
+    if (strcmp(argv[4], "win") != 0 && strcmp(argv[4], "score") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint64_t bits = 1;
+    for (int cell = 0; cell < s.cells; ++cell) {
+        bits *= s.target;
+        if (bits > MAX_VISITED_BITS) {
+            fprintf(stderr, "ERROR: state space of %dx%d up to %d is too big\n", s.rows, s.cols, target_tile);
+            return 1;
+        }
+    }
+
+    // The biggest sum of a board without the target tile, plus two layers of children
+    s.layer_count = (size_t)s.cells*(1ull << (s.target - 2)) + 3;
+    s.layers = calloc(s.layer_count, sizeof(*s.layers));
+    s.visited = calloc((bits + 63)/64, sizeof(*s.visited));
+    if (s.layers == NULL || s.visited == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        return 1;
+    }
+    solver_init_lines(&s);
+    pool_start(&s);
+    TRACE_THREAD_NAME("solver main");
+
+    size_t total = solver_enumerate(&s);
+    printf("INFO: %zu reachable states\n", total);
+    free(s.visited);
+    s.visited = NULL;
+
+    solver_evaluate(&s);
+    pool_stop(&s);
+    if (TRACE_FLUSH("solver_trace.json")) printf("INFO: trace written to solver_trace.json\n");
+
+    if (!solver_write(&s, argv[5], total)) return 1;
+    printf("INFO: tablebase written to %s\n", argv[5]);
+
+    return print_info(argv[5]);
+}
@@ -0,0 +1,259 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "raylib.h"
+#include "ai.h"
+#include "spectator.h"
+#include "trace.h"
+
+#ifndef PLATFORM_WEB
+    #include <pthread.h>
+    #include <stdio.h>
+    #include <time.h>
+#endif
+
+#define SPECTATOR_SLICE_TIME 0.006   // seconds of play per spectator_update() on the web
+#define SPECTATOR_SLICE_GAMES 16     // games played between two looks at the clock
+#define SPECTATOR_GAME_OVER_TIME 1.0 // a finished game stays on the screen this long
+#define SPECTATOR_IDLE_SLEEP 0.01    // when every game is waiting to restart
+
+#define SNAPSHOT_FRESH 4u // set in snapshot_middle until the renderer takes it
+
+
+// Owned by the player
+static Spectator_Game games[SPECTATOR_MAX_GAMES];
+static double over_since[SPECTATOR_MAX_GAMES];
+static int game_count = 0;
+static int board_size = DEFAULT_BOARD_SIZE;
+static int next_game = 0;
+static unsigned long long moves = 0;
+static unsigned long long games_finished = 0;
+static int best_exponent = 0;
+static unsigned long long published_sequence = 0;
+static unsigned int snapshot_back = 0;
+static unsigned int random_state = 2463534242u; // never 0
+
+// Owned by the renderer
+static unsigned int snapshot_front = 2;
+static bool running = false;
+
+// Shared
+static Spectator_Snapshot snapshots[3] = {0};
+static atomic_uint snapshot_middle = 1;
+
+#ifndef PLATFORM_WEB
+static pthread_t thread;
+static atomic_bool quit = false;
+#endif
+
+
+// xorshift32, rand() is not thread-safe and belongs to the main game
+static unsigned int next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+
+static void add_random_tile(Spectator_Game *game)
+{
+    int empty = 0;
+    for (int i = 0; i < board_size*board_size; ++i) {
+        if (game->cells[i] == 0) ++empty;
+    }
+    if (empty == 0) return;
+
+    int k = next_random() % empty;
+    for (int i = 0; i < board_size*board_size; ++i) {
+        if (game->cells[i] != 0) continue;
+        if (k-- == 0) {
+            game->cells[i] = next_random() % 100 < 90 ? 1 : 2;
+            return;
+        }
+    }
+}
+
+
+static void new_game(Spectator_Game *game)
+{
+    for (int i = 0; i < board_size*board_size; ++i) game->cells[i] = 0;
+    game->score = 0;
+    game->over = false;
+    add_random_tile(game);
+    add_random_tile(game);
+}
+
+
+// Returns false when the game did not move
+static bool play_game(int i, double now)
+{
+    Spectator_Game *game = &games[i];
+    if (game->over) {
+        if (now - over_since[i] < SPECTATOR_GAME_OVER_TIME) return false;
+        new_game(game);
+        return true;
+    }
+
+    int move = ai_quick_move(game->cells, board_size);
+    if (move < 0) {
+        game->over = true;
+        over_since[i] = now;
+        games_finished++;
+        return true;
+    }
+
+    long long gain;
+    ai_swipe(game->cells, board_size, move, &gain);
+    game->score += gain;
+    for (int c = 0; c < board_size*board_size; ++c) {
+        if (game->cells[c] > best_exponent) best_exponent = game->cells[c];
+    }
+    add_random_tile(game);
+    moves++;
+    return true;
+}
+
+
+// Plays the next `count` games round robin
+static bool play_games(int count, double now)
+{
+    TRACE_SCOPE("spectator_play");
+    bool moved = false;
+    for (int i = 0; i < count; ++i) {
+        if (play_game(next_game, now)) moved = true;
+        next_game = (next_game + 1) % game_count;
+    }
+    return moved;
+}
+
+
+// Copied by hand, the web build has no memcpy for bigger struct copies
+static void publish_snapshot(void)
+{
+    Spectator_Snapshot *snapshot = &snapshots[snapshot_back];
+    for (int i = 0; i < game_count; ++i) {
+        for (int c = 0; c < board_size*board_size; ++c) snapshot->games[i].cells[c] = games[i].cells[c];
+        snapshot->games[i].score = games[i].score;
+        snapshot->games[i].over = games[i].over;
+    }
+    snapshot->count = game_count;
+    snapshot->board_size = board_size;
+    snapshot->moves = moves;
+    snapshot->games_finished = games_finished;
+    snapshot->best_exponent = best_exponent;
+    snapshot->sequence = ++published_sequence;
+
+    unsigned int previous = atomic_exchange_explicit(&snapshot_middle, snapshot_back | SNAPSHOT_FRESH, memory_order_acq_rel);
+    snapshot_back = previous & ~SNAPSHOT_FRESH;
+}
+
+
+const Spectator_Snapshot *spectator_snapshot(void)
+{
+    if (atomic_load_explicit(&snapshot_middle, memory_order_relaxed) & SNAPSHOT_FRESH) {
+        unsigned int previous = atomic_exchange_explicit(&snapshot_middle, snapshot_front, memory_order_acq_rel);
+        snapshot_front = previous & ~SNAPSHOT_FRESH;
+    }
+    return &snapshots[snapshot_front];
+}
+
+
+// Only called while no player is running, so the renderer may touch the
+// player state
+static void reset_games(int count, int size)
+{
+    if (count < SPECTATOR_MIN_GAMES) count = SPECTATOR_MIN_GAMES;
+    if (count > SPECTATOR_MAX_GAMES) count = SPECTATOR_MAX_GAMES;
+    if (size < MIN_BOARD_SIZE || size > MAX_BOARD_SIZE) size = DEFAULT_BOARD_SIZE;
+
+    game_count = count;
+    board_size = size;
+    next_game = 0;
+    moves = 0;
+    games_finished = 0;
+    best_exponent = 0;
+    random_state ^= (unsigned int)(GetTime()*1e6);
+    if (random_state == 0) random_state = 2463534242u;
+    for (int i = 0; i < game_count; ++i) new_game(&games[i]);
+
+    snapshot_back = 0;
+    atomic_store(&snapshot_middle, 1);
+    snapshot_front = 2;
+    publish_snapshot();
+    spectator_snapshot();
+}
+
+
+#ifdef PLATFORM_WEB
+
+void spectator_start(int count, int size)
+{
+    reset_games(count, size);
+    running = true;
+}
+
+
+void spectator_stop(void)
+{
+    running = false;
+}
+
+
+void spectator_update(void)
+{
+    if (!running) return;
+    double deadline = GetTime() + SPECTATOR_SLICE_TIME;
+    double now;
+    while ((now = GetTime()) < deadline) {
+        if (!play_games(SPECTATOR_SLICE_GAMES, now)) break;
+    }
+    publish_snapshot();
+}
+
+#else
+
+static void *spectator_thread(void *arg)
+{
+    (void)arg;
+    TRACE_THREAD_NAME("spectator");
+    while (!atomic_load(&quit)) {
+        bool moved = play_games(game_count, GetTime());
+        publish_snapshot();
+        if (!moved) {
+            struct timespec wait = {.tv_sec = 0, .tv_nsec = SPECTATOR_IDLE_SLEEP*1e9};
+            nanosleep(&wait, NULL);
+        }
+    }
+    TRACE_THREAD_EXIT();
+    return NULL;
+}
+
+
+void spectator_start(int count, int size)
+{
+    spectator_stop();
+    reset_games(count, size);
+    atomic_store(&quit, false);
+    if (pthread_create(&thread, NULL, spectator_thread, NULL) != 0) {
+        fprintf(stderr, "ERROR: could not start the spectator thread\n");
+        exit(1);
+    }
+    running = true;
+}
+
+
+void spectator_stop(void)
+{
+    if (!running) return;
+    atomic_store(&quit, true);
+    pthread_join(thread, NULL);
+    running = false;
+}
+
+
+void spectator_update(void)
+{
+}
+
+#endif // PLATFORM_WEB
@@ -0,0 +1,39 @@
+#ifndef SPECTATOR_H_
+#define SPECTATOR_H_
+
+#include <stdbool.h>
+#include "2048.h"
+
+// Many games at once, each played by ai_quick_move() as fast as it goes, for
+// the spectator grid of the GUI. Natively they run on their own thread and
+// are published through a triple buffer of snapshots like the simulation,
+// the web build plays them in time slices from spectator_update().
+
+#define SPECTATOR_MIN_GAMES 16
+#define SPECTATOR_MAX_GAMES 256
+
+typedef struct {
+    unsigned char cells[MAX_BOARD_SIZE*MAX_BOARD_SIZE]; // exponents row by row, 0 is empty
+    long long score;
+    bool over;
+} Spectator_Game;
+
+typedef struct {
+    Spectator_Game games[SPECTATOR_MAX_GAMES];
+    int count;
+    int board_size;
+    unsigned long long moves;
+    unsigned long long games_finished;
+    int best_exponent;
+    unsigned long long sequence;
+} Spectator_Snapshot;
+
+// Starts `count` fresh games, stopping the ones that were running
+void spectator_start(int count, int board_size);
+void spectator_stop(void);
+// Plays a slice of the games on the calling thread, does nothing when they have their own thread
+void spectator_update(void);
+// The latest published snapshot, valid until the next call
+const Spectator_Snapshot *spectator_snapshot(void);
+
+#endif // SPECTATOR_H_
@@ -0,0 +1,116 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tablebase.h"
+
+
+bool tablebase_open(Tablebase *tb, const char *path)
+{
+    memset(tb, 0, sizeof(*tb));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: could not open tablebase %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Tablebase_Header)) {
+        fprintf(stderr, "ERROR: %s is not a tablebase\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "ERROR: could not map tablebase %s\n", path);
+        return false;
+    }
+
+    const Tablebase_Header *header = mapping;
+    size_t expected_size = sizeof(Tablebase_Header)
+                         + header->layer_count*sizeof(Tablebase_Layer)
+                         + header->state_count*(sizeof(uint64_t) + sizeof(float));
+    if (memcmp(header->magic, TABLEBASE_MAGIC, sizeof(TABLEBASE_MAGIC)) != 0
+        || (size_t)st.st_size != expected_size) {
+        fprintf(stderr, "ERROR: %s is not a tablebase\n", path);
+        munmap(mapping, st.st_size);
+        return false;
+    }
+
+    tb->header       = header;
+    tb->layers       = (const Tablebase_Layer*)(header + 1);
+    tb->states       = (const uint64_t*)(tb->layers + header->layer_count);
+    tb->values       = (const float*)(tb->states + header->state_count);
+    tb->mapping      = mapping;
+    tb->mapping_size = st.st_size;
+    return true;
+}
+
+
+void tablebase_close(Tablebase *tb)
+{
+    if (tb->mapping != NULL) munmap(tb->mapping, tb->mapping_size);
+    memset(tb, 0, sizeof(*tb));
+}
+
+
+// Pack a row-major array of rows*cols tile values (0, 2, 4, 8, ...)
+uint64_t tablebase_pack(const Tablebase *tb, const int *cells)
+{
+    int count = tb->header->rows*tb->header->cols;
+    uint64_t state = 0;
+    for (int i = 0; i < count; ++i) {
+        uint64_t exponent = 0;
+        for (int value = cells[i]; value > 1; value >>= 1) ++exponent;
+        state |= exponent << (4*i);
+    }
+    return state;
+}
+
+
+bool tablebase_lookup(const Tablebase *tb, uint64_t state, float *value)
+{
+    uint64_t sum = 0;
+    for (uint64_t s = state; s != 0; s >>= 4) {
+        if ((s & 0xF) != 0) sum += 1ull << (s & 0xF);
+    }
+
+    uint64_t k = sum/2;
+    if (k >= tb->header->layer_count) return false;
+
+    const uint64_t *states = tb->states + tb->layers[k].offset;
+    size_t lo = 0;
+    size_t hi = tb->layers[k].count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (states[mid] < state) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == tb->layers[k].count || states[lo] != state) return false;
+
+    *value = tb->values[tb->layers[k].offset + lo];
+    return true;
+}
+
+
+// Value of a new game: one random tile on an empty board
+float tablebase_start_value(const Tablebase *tb)
+{
+    int count = tb->header->rows*tb->header->cols;
+    double total = 0.0;
+    for (int i = 0; i < count; ++i) {
+        float two = 0.0f, four = 0.0f;
+        tablebase_lookup(tb, 1ull << (4*i), &two);
+        tablebase_lookup(tb, 2ull << (4*i), &four);
+        total += 0.9*two + 0.1*four;
+    }
+    return total/count;
+}
@@ -0,0 +1,55 @@
+#ifndef TABLEBASE_H_
+#define TABLEBASE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Tablebases are produced by the solver (see src/solver.c) for small boards.
+// A state is packed as 4 bits per cell holding the tile exponent (0 is an
+// empty cell, 1 is the tile 2, 2 is the tile 4, ...), cell (x, y) lives at
+// bits 4*(y*cols + x). States are grouped into layers by the sum of their
+// tiles: every move keeps the sum and every spawn adds 2 or 4 to it.
+
+#define TABLEBASE_MAGIC "2048TB1"
+#define TABLEBASE_MAX_CELLS 16
+#define TABLEBASE_MAX_EXPONENT 15
+
+typedef enum {
+    TABLEBASE_WIN,   // probability to build the target tile
+    TABLEBASE_SCORE, // expected score gained until the target tile or game over
+} Tablebase_Mode;
+
+typedef struct {
+    char     magic[8];
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t target;      // exponent of the target tile
+    uint32_t mode;        // Tablebase_Mode
+    uint64_t layer_count; // layer k holds the states whose tiles sum up to 2*k
+    uint64_t state_count;
+} Tablebase_Header;
+
+typedef struct {
+    uint64_t offset; // index of the first state of the layer
+    uint64_t count;
+} Tablebase_Layer;
+
+// File layout: header, layer_count layers, state_count sorted states
+// (uint64_t, sorted inside of every layer), state_count values (float).
+typedef struct {
+    const Tablebase_Header *header;
+    const Tablebase_Layer  *layers;
+    const uint64_t         *states;
+    const float            *values;
+    void                   *mapping;
+    size_t                  mapping_size;
+} Tablebase;
+
+bool tablebase_open(Tablebase *tb, const char *path);
+void tablebase_close(Tablebase *tb);
+uint64_t tablebase_pack(const Tablebase *tb, const int *cells);
+bool tablebase_lookup(const Tablebase *tb, uint64_t state, float *value);
+float tablebase_start_value(const Tablebase *tb);
+
+#endif // TABLEBASE_H_
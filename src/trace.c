@@ -0,0 +1,168 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+// Every thread owns one ring buffer and is the only writer of it, so
+// recording an event is a plain store plus a release store of the head.
+// trace_flush() walks the list of buffers with acquire loads; events that a
+// thread overwrites while the flush is reading them may come out garbled,
+// so flush when the traced threads are idle.
+//
+// Buffers are never freed. A thread that exits releases its buffer and the
+// next thread of the same name takes it over, events and tid included, so
+// threads that come and go (a spectator restart starts a new player) keep
+// one timeline and the memory stays bounded by the threads alive at once.
+
+#define TRACE_RING_SIZE 65536
+
+typedef struct {
+    const char *name;
+    uint64_t    ns;
+    char        phase; // 'B' or 'E'
+} Trace_Event;
+
+typedef struct Trace_Buffer {
+    Trace_Event          events[TRACE_RING_SIZE];
+    atomic_uint_fast64_t head; // number of events ever written
+    int                  tid;
+    const char          *thread_name;
+    atomic_bool          released;
+    struct Trace_Buffer *next;
+} Trace_Buffer;
+
+static _Atomic(Trace_Buffer*) buffers = NULL;
+static atomic_int next_tid = 1;
+static _Thread_local Trace_Buffer *local = NULL;
+
+
+static uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+
+static bool same_name(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL) return a == b;
+    return strcmp(a, b) == 0;
+}
+
+
+static Trace_Buffer *trace_claim_buffer(const char *thread_name)
+{
+    for (Trace_Buffer *buffer = atomic_load(&buffers); buffer != NULL; buffer = buffer->next) {
+        if (!same_name(buffer->thread_name, thread_name)) continue;
+        bool released = true;
+        if (atomic_compare_exchange_strong(&buffer->released, &released, false)) return buffer;
+    }
+
+    Trace_Buffer *buffer = calloc(1, sizeof(*buffer));
+    if (buffer == NULL) return NULL;
+    buffer->tid = atomic_fetch_add(&next_tid, 1);
+    buffer->thread_name = thread_name;
+    buffer->next = atomic_load(&buffers);
+    while (!atomic_compare_exchange_weak(&buffers, &buffer->next, buffer));
+    return buffer;
+}
+
+
+static Trace_Buffer *trace_local_buffer(void)
+{
+    if (local == NULL) local = trace_claim_buffer(NULL);
+    return local;
+}
+
+
+static void trace_push(const char *name, char phase)
+{
+    Trace_Buffer *buffer = trace_local_buffer();
+    if (buffer == NULL) return;
+
+    uint64_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    Trace_Event *event = &buffer->events[head % TRACE_RING_SIZE];
+    event->name  = name;
+    event->ns    = trace_now();
+    event->phase = phase;
+    atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+}
+
+
+void trace_begin(const char *name)
+{
+    trace_push(name, 'B');
+}
+
+
+void trace_end(const char *name)
+{
+    trace_push(name, 'E');
+}
+
+
+void trace_thread_name(const char *name)
+{
+    // Named before its first event, a thread can take over the buffer of an
+    // exited one
+    if (local == NULL) {
+        local = trace_claim_buffer(name);
+    } else {
+        local->thread_name = name;
+    }
+}
+
+
+void trace_thread_exit(void)
+{
+    if (local == NULL) return;
+    atomic_store(&local->released, true);
+    local = NULL;
+}
+
+
+void trace_scope_end_(const char **name)
+{
+    trace_push(*name, 'E');
+}
+
+
+bool trace_flush(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: could not open %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (Trace_Buffer *buffer = atomic_load(&buffers); buffer != NULL; buffer = buffer->next) {
+        if (buffer->thread_name != NULL) {
+            if (!first) fprintf(f, ",\n");
+            first = false;
+            fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    buffer->tid, buffer->thread_name);
+        }
+
+        uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        uint64_t tail = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for (uint64_t i = tail; i < head; ++i) {
+            const Trace_Event *event = &buffer->events[i % TRACE_RING_SIZE];
+            if (!first) fprintf(f, ",\n");
+            first = false;
+            fprintf(f, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                    event->name, event->phase, event->ns/1000.0, buffer->tid);
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+    if (!ok) fprintf(stderr, "ERROR: could not write %s\n", path);
+    return ok;
+}
@@ -0,0 +1,45 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+
+// Begin/end events recorded into a ring buffer per thread and flushed on
+// demand into a Chrome trace JSON file that chrome://tracing and
+// https://ui.perfetto.dev can open. The macros compile to nothing unless
+// the program is built with -DTRACE (native builds only).
+
+void trace_begin(const char *name);
+void trace_end(const char *name);
+void trace_thread_name(const char *name);
+// Hands the buffer of the calling thread to the next thread of the same name
+void trace_thread_exit(void);
+bool trace_flush(const char *path);
+void trace_scope_end_(const char **name);
+
+#if defined(TRACE) && !defined(PLATFORM_WEB)
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_BEGIN(name) trace_begin(name)
+#define TRACE_END(name) trace_end(name)
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#define TRACE_THREAD_EXIT() trace_thread_exit()
+#define TRACE_FLUSH(path) trace_flush(path)
+// Ends the event when the enclosing scope is left
+#define TRACE_SCOPE(name) \
+    const char *TRACE_CONCAT(trace_scope_, __LINE__) __attribute__((cleanup(trace_scope_end_))) = \
+        (trace_begin(name), name)
+
+#else
+
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_THREAD_EXIT() ((void)0)
+#define TRACE_FLUSH(path) false
+#define TRACE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif // TRACE_H_
@@ -0,0 +1,229 @@
+// The drawing functions of raylib for the web build. Instead of one call into
+// JavaScript per shape they append a command to a buffer in linear memory,
+// which raylib.js replays on the canvas in EndDrawing(), so a frame crosses
+// over once. Commands are made of 32-bit words: a header with the kind in the
+// low 8 bits and the length in words (header included) above, then the
+// arguments laid out like the structs of raylib.h, with colors as their 4
+// bytes and numbers as floats. Strings follow NUL-terminated and padded to a
+// word. The order of Draw_Command_Kind is repeated in js/raylib.js.
+#ifdef PLATFORM_WEB
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "raylib.h"
+
+#define DRAW_COMMANDS_CAPACITY (64*1024) // words, a full spectator grid takes about 75k
+
+typedef enum {
+    DRAW_CLEAR_BACKGROUND,
+    DRAW_RECTANGLE,
+    DRAW_RECTANGLE_REC,
+    DRAW_RECTANGLE_ROUNDED,
+    DRAW_TRIANGLE,
+    DRAW_RING,
+    DRAW_TEXT,
+    DRAW_TEXT_EX,
+    DRAW_TEXTURE_PRO,
+    DRAW_BEGIN_TEXTURE_MODE,
+    DRAW_END_TEXTURE_MODE,
+    DRAW_BEGIN_MODE_2D,
+    DRAW_END_MODE_2D,
+} Draw_Command_Kind;
+
+typedef union {
+    unsigned int u;
+    float f;
+    Color color;
+} Draw_Word;
+
+typedef struct {
+    unsigned int size; // words in use, set back to 0 by raylib.js after replaying them
+    Draw_Word words[DRAW_COMMANDS_CAPACITY];
+} Draw_Commands;
+
+static Draw_Commands commands = {0};
+static bool registered = false;
+
+void raylib_js_set_draw_commands(Draw_Commands *commands);
+void raylib_js_flush_draw_commands(void);
+
+
+// Room for a command of `size` words after the header, NULL if it could never fit
+static Draw_Word *begin_command(Draw_Command_Kind kind, unsigned int size)
+{
+    if (!registered) {
+        raylib_js_set_draw_commands(&commands);
+        registered = true;
+    }
+    size += 1;
+    if (size > DRAW_COMMANDS_CAPACITY) return NULL;
+    if (commands.size + size > DRAW_COMMANDS_CAPACITY) raylib_js_flush_draw_commands();
+
+    Draw_Word *header = &commands.words[commands.size];
+    header->u = kind | size << 8;
+    commands.size += size;
+    return header + 1;
+}
+
+
+static int text_length(const char *text)
+{
+    int length = 0;
+    while (text[length] != '\0') ++length;
+    return length;
+}
+
+
+// Copied by hand, the web build has no memcpy
+static void put_text(Draw_Word *words, const char *text, int length)
+{
+    unsigned char *bytes = (unsigned char *)words;
+    for (int i = 0; i < length; ++i) bytes[i] = text[i];
+    for (int i = length; i < (length/4 + 1)*4; ++i) bytes[i] = 0;
+}
+
+
+static void put_rectangle(Draw_Word *words, Rectangle rec)
+{
+    words[0].f = rec.x;
+    words[1].f = rec.y;
+    words[2].f = rec.width;
+    words[3].f = rec.height;
+}
+
+
+static void put_vector(Draw_Word *words, Vector2 v)
+{
+    words[0].f = v.x;
+    words[1].f = v.y;
+}
+
+
+void ClearBackground(Color color)
+{
+    Draw_Word *words = begin_command(DRAW_CLEAR_BACKGROUND, 1);
+    words[0].color = color;
+}
+
+
+void DrawRectangle(int posX, int posY, int width, int height, Color color)
+{
+    Draw_Word *words = begin_command(DRAW_RECTANGLE, 5);
+    words[0].f = posX;
+    words[1].f = posY;
+    words[2].f = width;
+    words[3].f = height;
+    words[4].color = color;
+}
+
+
+void DrawRectangleRec(Rectangle rec, Color color)
+{
+    Draw_Word *words = begin_command(DRAW_RECTANGLE_REC, 5);
+    put_rectangle(words, rec);
+    words[4].color = color;
+}
+
+
+void DrawRectangleRounded(Rectangle rec, float roundness, int segments, Color color)
+{
+    Draw_Word *words = begin_command(DRAW_RECTANGLE_ROUNDED, 7);
+    put_rectangle(words, rec);
+    words[4].f = roundness;
+    words[5].f = segments;
+    words[6].color = color;
+}
+
+
+void DrawTriangle(Vector2 v1, Vector2 v2, Vector2 v3, Color color)
+{
+    Draw_Word *words = begin_command(DRAW_TRIANGLE, 7);
+    put_vector(words, v1);
+    put_vector(words + 2, v2);
+    put_vector(words + 4, v3);
+    words[6].color = color;
+}
+
+
+void DrawRing(Vector2 center, float innerRadius, float outerRadius, float startAngle, float endAngle, int segments, Color color)
+{
+    Draw_Word *words = begin_command(DRAW_RING, 8);
+    put_vector(words, center);
+    words[2].f = innerRadius;
+    words[3].f = outerRadius;
+    words[4].f = startAngle;
+    words[5].f = endAngle;
+    words[6].f = segments;
+    words[7].color = color;
+}
+
+
+void DrawText(const char *text, int posX, int posY, int fontSize, Color color)
+{
+    int length = text_length(text);
+    Draw_Word *words = begin_command(DRAW_TEXT, 4 + length/4 + 1);
+    if (words == NULL) return;
+    words[0].f = posX;
+    words[1].f = posY;
+    words[2].f = fontSize;
+    words[3].color = color;
+    put_text(words + 4, text, length);
+}
+
+
+// The font is left out, raylib.js draws every text with the one it loaded
+void DrawTextEx(Font font, const char *text, Vector2 position, float fontSize, float spacing, Color tint)
+{
+    (void)font;
+    int length = text_length(text);
+    Draw_Word *words = begin_command(DRAW_TEXT_EX, 5 + length/4 + 1);
+    if (words == NULL) return;
+    put_vector(words, position);
+    words[2].f = fontSize;
+    words[3].f = spacing;
+    words[4].color = tint;
+    put_text(words + 5, text, length);
+}
+
+
+void DrawTexturePro(Texture2D texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint)
+{
+    Draw_Word *words = begin_command(DRAW_TEXTURE_PRO, 13);
+    words[0].u = texture.id;
+    put_rectangle(words + 1, source);
+    put_rectangle(words + 5, dest);
+    put_vector(words + 9, origin);
+    words[11].f = rotation;
+    words[12].color = tint;
+}
+
+
+void BeginTextureMode(RenderTexture2D target)
+{
+    Draw_Word *words = begin_command(DRAW_BEGIN_TEXTURE_MODE, 1);
+    words[0].u = target.id;
+}
+
+
+void EndTextureMode(void)
+{
+    begin_command(DRAW_END_TEXTURE_MODE, 0);
+}
+
+
+void BeginMode2D(Camera2D camera)
+{
+    Draw_Word *words = begin_command(DRAW_BEGIN_MODE_2D, 6);
+    put_vector(words, camera.offset);
+    put_vector(words + 2, camera.target);
+    words[4].f = camera.rotation;
+    words[5].f = camera.zoom;
+}
+
+
+void EndMode2D(void)
+{
+    begin_command(DRAW_END_MODE_2D, 0);
+}
+
+#endif // PLATFORM_WEB
@@ -0,0 +1,225 @@
+// The functions of the phony include/math.h for the web build. Compiled into
+// the module, so drawing a frame never calls into JavaScript for math.
+// Whatever WebAssembly has an instruction for (sqrt, floor, abs, min, max)
+// goes through the compiler builtins, the rest are polynomials evaluated in
+// double precision after reducing the argument to a small interval.
+#ifdef PLATFORM_WEB
+
+#include <math.h>
+
+#define PI_ 3.14159265358979323846
+#define HALF_PI_HI 1.57079632673412561417   // pi/2 split in two so that
+#define HALF_PI_LO 6.07710050650619224932e-11 // k*pi/2 is subtracted exactly
+#define LN2 0.69314718055994530942
+#define SQRT3 1.73205080756887729353
+#define TAN_PI_12 0.26794919243112270647
+
+typedef union {
+    double value;
+    unsigned long long bits;
+} Double_Bits;
+
+
+float floorf(float x) { return __builtin_floorf(x); }
+float fabsf(float x) { return __builtin_fabsf(x); }
+double fabs(double x) { return __builtin_fabs(x); }
+float fmaxf(float a, float b) { return __builtin_fmaxf(a, b); }
+float fminf(float a, float b) { return __builtin_fminf(a, b); }
+float sqrtf(float x) { return __builtin_sqrtf(x); }
+
+
+// Taylor series up to x^17 and x^16, accurate to double precision on [-pi/4, pi/4]
+static double sin_poly(double x)
+{
+    double x2 = x*x;
+    return x*(1 + x2*(-1.0/6 + x2*(1.0/120 + x2*(-1.0/5040 + x2*(1.0/362880 + x2*(-1.0/39916800
+        + x2*(1.0/6227020800 + x2*(-1.0/1307674368000 + x2*(1.0/355687428096000)))))))));
+}
+
+
+static double cos_poly(double x)
+{
+    double x2 = x*x;
+    return 1 + x2*(-1.0/2 + x2*(1.0/24 + x2*(-1.0/720 + x2*(1.0/40320 + x2*(-1.0/3628800
+        + x2*(1.0/479001600 + x2*(-1.0/87178291200 + x2*(1.0/20922789888000))))))));
+}
+
+
+// x - k*pi/2 with the quadrant k modulo 4
+static double reduce_quarter_turns(double x, int *quadrant)
+{
+    double k = __builtin_floor(x*(2/PI_) + 0.5);
+    *quadrant = (int)(k - 4*__builtin_floor(k/4));
+    return (x - k*HALF_PI_HI) - k*HALF_PI_LO;
+}
+
+
+float sinf(float x)
+{
+    int quadrant;
+    double r = reduce_quarter_turns(x, &quadrant);
+    switch (quadrant) {
+        case 0:  return sin_poly(r);
+        case 1:  return cos_poly(r);
+        case 2:  return -sin_poly(r);
+        default: return -cos_poly(r);
+    }
+}
+
+
+float cosf(float x)
+{
+    int quadrant;
+    double r = reduce_quarter_turns(x, &quadrant);
+    switch (quadrant) {
+        case 0:  return cos_poly(r);
+        case 1:  return -sin_poly(r);
+        case 2:  return -cos_poly(r);
+        default: return sin_poly(r);
+    }
+}
+
+
+double tan(double x)
+{
+    int quadrant;
+    double r = reduce_quarter_turns(x, &quadrant);
+    double s = sin_poly(r);
+    double c = cos_poly(r);
+    return quadrant % 2 == 0 ? s/c : -c/s;
+}
+
+
+// atan(x) for |x| <= 1, shifted by pi/6 down to |x| <= tan(pi/12) where the
+// series converges fast
+static double atan_reduced(double x)
+{
+    double offset = 0.0;
+    if (x > TAN_PI_12) {
+        x = (x*SQRT3 - 1)/(SQRT3 + x);
+        offset = PI_/6;
+    } else if (x < -TAN_PI_12) {
+        x = (x*SQRT3 + 1)/(SQRT3 - x);
+        offset = -PI_/6;
+    }
+    double x2 = x*x;
+    double sum = 0.0;
+    for (int n = 25; n >= 1; n -= 2) sum = 1.0/n - x2*sum;
+    return offset + x*sum;
+}
+
+
+static double atan_(double x)
+{
+    if (x > 1) return PI_/2 - atan_reduced(1/x);
+    if (x < -1) return -PI_/2 - atan_reduced(1/x);
+    return atan_reduced(x);
+}
+
+
+float atan2f(float y, float x)
+{
+    if (x == 0) {
+        if (y > 0) return PI_/2;
+        if (y < 0) return -PI_/2;
+        return 0;
+    }
+    double angle = atan_((double)y/x);
+    if (x > 0) return angle;
+    return y < 0 ? angle - PI_ : angle + PI_;
+}
+
+
+float asinf(float x)
+{
+    if (x < -1 || x > 1) return __builtin_nanf("");
+    return atan2f(x, __builtin_sqrt(1 - (double)x*x));
+}
+
+
+float acosf(float x)
+{
+    if (x < -1 || x > 1) return __builtin_nanf("");
+    return atan2f(__builtin_sqrt(1 - (double)x*x), x);
+}
+
+
+double log2(double x)
+{
+    if (x != x || x < 0) return __builtin_nan("");
+    if (x == 0) return -__builtin_inf();
+    if (x == __builtin_inf()) return x;
+
+    Double_Bits d = {.value = x};
+    int exponent = 0;
+    if ((d.bits >> 52) == 0) {
+        // Subnormal, scale it up by 2^54 first
+        d.value *= 18014398509481984.0;
+        exponent = -54;
+    }
+    exponent += (int)(d.bits >> 52) - 1023;
+    d.bits = (d.bits & 0x000fffffffffffffull) | 0x3ff0000000000000ull;
+    double m = d.value; // in [1, 2)
+    if (m > 1.41421356237309504880) {
+        m /= 2;
+        exponent++;
+    }
+
+    // ln(m) = 2*atanh(s) with |s| <= 0.172
+    double s = (m - 1)/(m + 1);
+    double s2 = s*s;
+    double sum = 0.0;
+    for (int n = 23; n >= 1; n -= 2) sum = 1.0/n + s2*sum;
+    return exponent + 2*s*sum/LN2;
+}
+
+
+// 2^x for finite x, splitting off the integer part into the exponent bits
+static double exp2_(double x)
+{
+    if (x > 1024) return __builtin_inf();
+    if (x < -1075) return 0.0;
+
+    double n = __builtin_floor(x + 0.5);
+    double f = (x - n)*LN2; // |f| <= ln(2)/2
+    double sum = 1.0;
+    for (int k = 16; k >= 1; --k) sum = 1.0 + f*sum/k;
+
+    // Two steps so 2^n stays representable down to the subnormals
+    int half = (int)n/2;
+    Double_Bits a = {.bits = (unsigned long long)(half + 1023) << 52};
+    Double_Bits b = {.bits = (unsigned long long)((int)n - half + 1023) << 52};
+    return sum*a.value*b.value;
+}
+
+
+double pow(double x, double y)
+{
+    if (y == 0) return 1.0;
+    if (x != x || y != y) return __builtin_nan("");
+
+    // Integer powers by repeated squaring are exact for the small ones
+    if (y == __builtin_floor(y) && __builtin_fabs(y) <= 64) {
+        int n = (int)__builtin_fabs(y);
+        double result = 1.0;
+        double base = x;
+        while (n > 0) {
+            if (n & 1) result *= base;
+            base *= base;
+            n >>= 1;
+        }
+        return y < 0 ? 1.0/result : result;
+    }
+
+    if (x == 0) return y > 0 ? 0.0 : __builtin_inf();
+    if (x < 0) {
+        if (y != __builtin_floor(y)) return __builtin_nan("");
+        // Odd integers keep the sign, 2^53 and up are all even
+        double magnitude = exp2_(y*log2(-x));
+        double half = y/2;
+        return half == __builtin_floor(half) ? magnitude : -magnitude;
+    }
+    return exp2_(y*log2(x));
+}
+
+#endif // PLATFORM_WEB